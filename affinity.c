@@ -0,0 +1,352 @@
+/*
+ * Filename: affinity.c
+ * Date:     2026/10/19
+ */
+
+#define _GNU_SOURCE // cpu_set_t, pthread_setaffinity_np()
+
+#include <math.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pthread.h>
+
+#include "affinity.h"
+
+#define MAX_NODES 64
+#define PATH_LEN 512
+
+typedef struct {
+   int cpu;
+   int node;
+   int package;
+   int core;
+} cpu_info;
+
+static bool enabled;
+static int compute[CPU_SETSIZE]; // the compute cpus in the order of the workers
+static int n_compute;
+static cpu_set_t io_set;
+static cpu_set_t compute_set; // all the compute cpus, shared by the colour workers
+static bool reported[CPU_SETSIZE]; // compute indices already printed (atomic)
+
+// - function -----------------------------------------------------------------
+static int read_int(const char *path, int def)
+{
+   FILE *f = fopen(path, "r");
+   int v;
+   if (f == NULL) {
+      return def;
+   }
+   if (fscanf(f, "%d", &v) != 1) {
+      v = def;
+   }
+   fclose(f);
+   return v;
+}
+
+// - function -----------------------------------------------------------------
+// "0-3,8,10-11" into set, false on a syntax error
+static bool parse_list(const char *s, cpu_set_t *set)
+{
+   CPU_ZERO(set);
+   while (*s) {
+      char *end;
+      const long a = strtol(s, &end, 10);
+      long b = a;
+      if (end == s) {
+         return false;
+      }
+      if (*end == '-') {
+         s = end + 1;
+         b = strtol(s, &end, 10);
+         if (end == s) {
+            return false;
+         }
+      }
+      for (long i = a; i <= b && i < CPU_SETSIZE; ++i) {
+         if (i >= 0) {
+            CPU_SET(i, set);
+         }
+      }
+      s = end;
+      if (*s == ',') {
+         ++s;
+      } else if (*s && *s != '\n') {
+         return false;
+      } else {
+         break;
+      }
+   }
+   return true;
+}
+
+// - function -----------------------------------------------------------------
+static void format_list(const cpu_set_t *set, char *buf, int size)
+{
+   int len = 0;
+   buf[0] = '\0';
+   for (int i = 0; i < CPU_SETSIZE && len < size; ++i) {
+      if (!CPU_ISSET(i, set)) {
+         continue;
+      }
+      int j = i;
+      while (j + 1 < CPU_SETSIZE && CPU_ISSET(j + 1, set)) {
+         ++j;
+      }
+      len += snprintf(buf + len, size - len, j > i ? "%s%d-%d" : "%s%d", len ? "," : "", i, j);
+      i = j;
+   }
+}
+
+// - function -----------------------------------------------------------------
+static void node_map(int *node)
+{
+   char path[PATH_LEN];
+   cpu_set_t set;
+   for (int n = 0; n < MAX_NODES; ++n) { // node numbers may have holes
+      snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", n);
+      FILE *f = fopen(path, "r");
+      char line[PATH_LEN];
+      if (f == NULL) {
+         continue;
+      }
+      if (fgets(line, sizeof(line), f) && parse_list(line, &set)) {
+         for (int i = 0; i < CPU_SETSIZE; ++i) {
+            if (CPU_ISSET(i, &set)) {
+               node[i] = n;
+            }
+         }
+      }
+      fclose(f);
+   }
+}
+
+// - function -----------------------------------------------------------------
+// cpus the cgroup (v2 or v1) of the process may use, 0 if it is not limited;
+// the tightest limit of the cgroup and its parents
+static double cgroup_quota(void)
+{
+   char path[PATH_LEN] = "";
+   char line[PATH_LEN];
+   double quota = 0;
+   long q;
+   long period;
+   FILE *f = fopen("/proc/self/cgroup", "r");
+   while (f && fgets(line, sizeof(line), f)) {
+      if (strncmp(line, "0::", 3) == 0) {
+         line[strcspn(line, "\n")] = '\0';
+         snprintf(path, sizeof(path), "%s", strcmp(line + 3, "/") ? line + 3 : "");
+      }
+   }
+   if (f) {
+      fclose(f);
+   }
+   while (true) {
+      char file[2 * PATH_LEN];
+      snprintf(file, sizeof(file), "/sys/fs/cgroup%s/cpu.max", path);
+      if ((f = fopen(file, "r")) != NULL) {
+         if (fscanf(f, "%ld %ld", &q, &period) == 2 && period > 0 && (quota == 0 || (double)q / period < quota)) {
+            quota = (double)q / period; // "max 100000" is not matched
+         }
+         fclose(f);
+      }
+      char *slash = strrchr(path, '/');
+      if (slash == NULL) {
+         break;
+      }
+      *slash = '\0';
+   }
+   q = read_int("/sys/fs/cgroup/cpu/cpu.cfs_quota_us", -1); // v1, -1 for no limit
+   period = read_int("/sys/fs/cgroup/cpu/cpu.cfs_period_us", 0);
+   if (q > 0 && period > 0 && (quota == 0 || (double)q / period < quota)) {
+      quota = (double)q / period;
+   }
+   return quota;
+}
+
+// - function -----------------------------------------------------------------
+static int cmp_cpu(const void *a, const void *b)
+{
+   const cpu_info *x = (const cpu_info*)a;
+   const cpu_info *y = (const cpu_info*)b;
+   if (x->node != y->node) {
+      return x->node - y->node;
+   }
+   if (x->package != y->package) {
+      return x->package - y->package;
+   }
+   return x->core != y->core ? x->core - y->core : x->cpu - y->cpu;
+}
+
+// - function -----------------------------------------------------------------
+static bool same_core(const cpu_info *a, const cpu_info *b)
+{
+   return a->node == b->node && a->package == b->package && a->core == b->core;
+}
+
+// - function -----------------------------------------------------------------
+// one compute cpu per physical core, node by node, the last core of the first
+// node (or the last one) for the I/O
+static void plan_auto(const cpu_set_t *allowed, double quota, int *n_cores, int *n_nodes)
+{
+   static cpu_info cpus[CPU_SETSIZE];
+   static int node[CPU_SETSIZE];
+   char path[PATH_LEN];
+   int n = 0;
+   node_map(node);
+   for (int i = 0; i < CPU_SETSIZE; ++i) {
+      if (CPU_ISSET(i, allowed)) {
+         snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", i);
+         const int package = read_int(path, 0);
+         snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", i);
+         cpus[n++] = (cpu_info){ i, node[i], package, read_int(path, i) }; // unknown topology, every cpu a core
+      }
+   }
+   qsort(cpus, n, sizeof(cpu_info), cmp_cpu);
+   int first[CPU_SETSIZE]; // the first cpu of every core in cpus
+   int cores = 0;
+   int first_node = 0; // cores of the first node
+   *n_nodes = 0;
+   for (int i = 0; i < n; ++i) {
+      if (i == 0 || !same_core(&cpus[i], &cpus[i - 1])) {
+         first[cores++] = i;
+         first_node += cpus[i].node == cpus[0].node;
+         *n_nodes += i == 0 || cpus[i].node != cpus[i - 1].node;
+      }
+   }
+   *n_cores = cores;
+   CPU_ZERO(&io_set);
+   n_compute = 0;
+   const int io_core = cores < 2 ? -1 : (first_node >= 2 ? first_node - 1 : cores - 1);
+   for (int c = 0; c < cores; ++c) {
+      const int end = c + 1 < cores ? first[c + 1] : n;
+      if (c == io_core) {
+         for (int i = first[c]; i < end; ++i) {
+            CPU_SET(cpus[i].cpu, &io_set);
+         }
+      } else {
+         compute[n_compute++] = cpus[first[c]].cpu;
+      }
+   }
+   if (io_core < 0) { // a single core: its siblings for the I/O if it has any
+      for (int i = 1; i < n; ++i) {
+         CPU_SET(cpus[i].cpu, &io_set);
+      }
+      if (n < 2) {
+         CPU_SET(cpus[0].cpu, &io_set);
+      }
+   }
+   if (quota > 0) { // a cpu of the quota for the I/O
+      const int limit = (int)ceil(quota) - 1;
+      n_compute = limit < 1 ? 1 : (limit < n_compute ? limit : n_compute);
+   }
+}
+
+// - function -----------------------------------------------------------------
+bool affinity_init(const char *policy)
+{
+   if (policy == NULL) {
+      policy = getenv(AFFINITY_ENV);
+   }
+   if (policy == NULL || *policy == '\0' || strcmp(policy, "off") == 0) {
+      return true;
+   }
+   cpu_set_t allowed;
+   if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+      fprintf(stderr, "\033[1;33mWARNING\033[0m: Unable to get the cpus of the process, the placement is off\r\n");
+      return true;
+   }
+   const double quota = cgroup_quota();
+   int n_cores = 0;
+   int n_nodes = 0;
+   const char *slash = strchr(policy, '/');
+   if (strcmp(policy, "auto") == 0) {
+      plan_auto(&allowed, quota, &n_cores, &n_nodes);
+   } else if (slash) { // explicit COMPUTE/IO lists
+      char list[PATH_LEN];
+      cpu_set_t set;
+      snprintf(list, sizeof(list), "%.*s", (int)(slash - policy), policy);
+      if (!parse_list(list, &set) || !parse_list(slash + 1, &io_set)) {
+         fprintf(stderr, "\033[1;31mERROR\033[0m: Bad cpu lists '%s'\r\n", policy);
+         return false;
+      }
+      CPU_AND(&set, &set, &allowed);
+      CPU_AND(&io_set, &io_set, &allowed);
+      n_compute = 0;
+      for (int i = 0; i < CPU_SETSIZE; ++i) {
+         if (CPU_ISSET(i, &set)) {
+            compute[n_compute++] = i;
+         }
+      }
+   } else {
+      fprintf(stderr, "\033[1;31mERROR\033[0m: Unknown placement '%s', use off, auto or COMPUTE/IO cpu lists\r\n", policy);
+      return false;
+   }
+   if (n_compute == 0 || CPU_COUNT(&io_set) == 0) {
+      fprintf(stderr, "\033[1;31mERROR\033[0m: The placement '%s' leaves no compute or I/O cpu\r\n", policy);
+      return false;
+   }
+   cpu_set_t set;
+   CPU_ZERO(&set);
+   for (int i = 0; i < n_compute; ++i) {
+      CPU_SET(compute[i], &set);
+   }
+   compute_set = set;
+   char c[PATH_LEN];
+   char io[PATH_LEN];
+   char all[PATH_LEN];
+   format_list(&set, c, sizeof(c));
+   format_list(&io_set, io, sizeof(io));
+   format_list(&allowed, all, sizeof(all));
+   fprintf(stderr, "\033[1;34mAFFINITY\033[0m: %s, cpus %s", policy, all);
+   if (n_cores > 0) {
+      fprintf(stderr, " (%d cores, %d nodes)", n_cores, n_nodes);
+   }
+   if (quota > 0) {
+      fprintf(stderr, ", cgroup quota %.2f cpus", quota);
+   }
+   fprintf(stderr, ": %d compute on %s, I/O and present on %s%s\r\n", n_compute, c, io, CPU_COUNT(&set) + CPU_COUNT(&io_set) > CPU_COUNT(&allowed) ? " (shared)" : "");
+   enabled = true;
+   return true;
+}
+
+// - function -----------------------------------------------------------------
+int affinity_workers(void)
+{
+   return enabled ? n_compute : 0;
+}
+
+// - function -----------------------------------------------------------------
+void affinity_pin(affinity_role role, int index, const char *name)
+{
+   if (!enabled) {
+      return;
+   }
+   cpu_set_t set;
+   if (role == AFFINITY_COMPUTE) {
+      index %= n_compute;
+      CPU_ZERO(&set);
+      CPU_SET(compute[index], &set);
+   } else if (role == AFFINITY_COLOUR) {
+      set = compute_set;
+   } else {
+      set = io_set;
+   }
+   const int r = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+   // the workers start with every frame, each of them is reported once
+   if (role == AFFINITY_COMPUTE && __atomic_exchange_n(&reported[index], true, __ATOMIC_RELAXED)) {
+      return;
+   }
+   char list[PATH_LEN];
+   format_list(&set, list, sizeof(list));
+   if (r != 0) {
+      fprintf(stderr, "\033[1;33mWARNING\033[0m: Unable to pin the %s thread to cpus %s\r\n", name, list);
+   } else {
+      fprintf(stderr, "\033[1;34mAFFINITY\033[0m: %s thread on cpus %s, now on cpu %d\r\n", name, list, sched_getcpu());
+   }
+}
+
+/* end of affinity.c */
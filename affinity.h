@@ -0,0 +1,53 @@
+/*
+ * Filename: affinity.h
+ * Date:     2026/10/19
+ *
+ * Placement of the threads on the cpus. The compute threads get one physical
+ * core each, the pipe I/O, keyboard, alarm and SDL present threads share a
+ * core of their own, so neither migrates nor meets the other on an SMT
+ * sibling. The cores are taken node by node and as many as the cgroup cpu
+ * quota allows. Off unless asked for by --affinity or PRGSEM_AFFINITY.
+ */
+
+#ifndef __AFFINITY_H__
+#define __AFFINITY_H__
+
+#include <stdbool.h>
+
+#define AFFINITY_ENV "PRGSEM_AFFINITY"
+
+typedef enum {
+   AFFINITY_COMPUTE,  // compute workers
+   AFFINITY_IO,       // pipe I/O, keyboard, alarm and present threads
+   AFFINITY_COLOUR,   // colour workers, free to move among the compute cpus
+} affinity_role;
+
+/// ----------------------------------------------------------------------------
+/// @brief affinity_init -- make the placement plan and print it to stderr
+///
+/// @param policy -- off, auto (one compute thread per physical core, one core
+///                  kept for the I/O), or COMPUTE/IO cpu lists such as
+///                  0-5/6,7; NULL for the value of PRGSEM_AFFINITY, off if
+///                  it is not set
+/// @return false if the policy cannot be parsed or leaves no cpu
+/// ----------------------------------------------------------------------------
+bool affinity_init(const char *policy);
+
+/// ----------------------------------------------------------------------------
+/// @brief affinity_workers -- number of compute cpus of the plan, 0 if the
+/// placement is off
+/// ----------------------------------------------------------------------------
+int affinity_workers(void);
+
+/// ----------------------------------------------------------------------------
+/// @brief affinity_pin -- bind the calling thread by its role, a compute
+/// thread to the index-th compute cpu (modulo their number); nothing if the
+/// placement is off
+///
+/// @param name -- of the thread in the report
+/// ----------------------------------------------------------------------------
+void affinity_pin(affinity_role role, int index, const char *name);
+
+#endif
+
+/* end of affinity.h */
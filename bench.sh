@@ -0,0 +1,51 @@
+#!/bin/sh
+#
+# End-to-end benchmark: run the module and a headless prgsem-main over the
+# real FIFOs for each fixed scene and print the results as one JSON document.
+#
+# usage: ./bench.sh [module binary | cpu] [scene ...]
+#        ./bench.sh ./module
+#        ./bench.sh bin/prgsem-comp_module default zoom
+#        ./bench.sh cpu          (local compute in prgsem-main, no module)
+#        MAIN_ARGS=--hybrid ./bench.sh ./module
+#        MODULE_ARGS="--kernel double" ./bench.sh ./module
+#
+
+MODULE=${1:-./module}
+[ $# -gt 0 ] && shift
+SCENES=${*:-"default interior zoom"}
+MAIN=./prgsem-main
+TIMEOUT=${BENCH_TIMEOUT:-300}
+
+for p in /tmp/pipe.in /tmp/pipe.out; do
+   [ -p $p ] || mkfifo $p || exit 1
+done
+
+case $(basename "$MODULE") in
+   prgsem-comp_module*) # the reference module opens its own pipe names
+      ln -sf /tmp/pipe.out /tmp/computational_module.in
+      ln -sf /tmp/pipe.in /tmp/computational_module.out
+      ;;
+esac
+
+printf '{"module": "%s", "host": "%s", "cpus": %s, "scenes": [' "$MODULE" "$(uname -srm)" "$(nproc)"
+sep=""
+for scene in $SCENES; do
+   if [ "$MODULE" = cpu ]; then
+      result=$(timeout "$TIMEOUT" $MAIN --headless --cpu --scene "$scene" 2>/dev/null)
+      [ -n "$result" ] || result="{\"scene\": \"$scene\", \"complete\": false}"
+      printf '%s\n   %s' "$sep" "$result"
+      sep=","
+      continue
+   fi
+   "$MODULE" $MODULE_ARGS </dev/null >/dev/null 2>&1 &
+   pid=$!
+   result=$(timeout "$TIMEOUT" $MAIN --headless $MAIN_ARGS --scene "$scene" 2>/dev/null)
+   [ -n "$result" ] || result="{\"scene\": \"$scene\", \"complete\": false}"
+   printf '%s\n   %s' "$sep" "$result"
+   sep=","
+   sleep 0.2
+   kill $pid 2>/dev/null # the reference module does not quit on 'q'
+   wait $pid 2>/dev/null
+done
+printf '\n]}\n'
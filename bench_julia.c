@@ -0,0 +1,124 @@
+/*
+ * Filename: bench_julia.c
+ * Date:     2026/10/19
+ *
+ * Microbenchmark of the libjulia kernel - full frames of the fixed scenes
+ * computed in-process, without the module and the pipes.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "julia.h"
+#include "scenes.h"
+
+#define W 640
+#define H 480
+#define DEFAULT_REPEAT 10
+#define WARMUP 1
+
+// - function -----------------------------------------------------------------
+static double get_time(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// - function -----------------------------------------------------------------
+static int cmp_double(const void *a, const void *b)
+{
+   double d = *(const double*)a - *(const double*)b;
+   return d < 0 ? -1 : (d > 0);
+}
+
+// - function -----------------------------------------------------------------
+static void compute_frame(julia_kernel k, const julia_params_dd *p, uint8_t *frame)
+{
+   // the reference orbit is a part of the frame cost, as in the cpu engine
+   julia_orbit *o = k == JULIA_PERTURB ? julia_orbit_create(p, julia_coord(p->re, p->d_re, W / 2), julia_coord(p->im, p->d_im, H / 2)) : NULL;
+   julia_compute_kernel(k, p, o, 0, 0, W, H, frame, W);
+   julia_orbit_free(o);
+}
+
+// - function -----------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+   int repeat = DEFAULT_REPEAT;
+   int json = 0;
+   int kernel = -1; // chosen by julia_select() for each scene
+   int opt;
+   while ((opt = getopt(argc, argv, "r:jk:")) != -1) {
+      switch (opt) {
+         case 'r': repeat = atoi(optarg); break;
+         case 'j': json = 1; break;
+         case 'k':
+            kernel = julia_kernel_find(optarg);
+            if (kernel < JULIA_KERNELS) {
+               break;
+            } // fall through
+         default:
+            fprintf(stderr, "usage: %s [-r repetitions] [-j] [-k float|double|dd|perturb|float128]\n", argv[0]);
+            return EXIT_FAILURE;
+      }
+   }
+   if (repeat < 1) {
+      fprintf(stderr, "ERROR: Number of repetitions must be positive\n");
+      return EXIT_FAILURE;
+   }
+
+   uint8_t *frame = malloc(W * H);
+   double *t = malloc(repeat * sizeof(double));
+   if (!frame || !t) {
+      fprintf(stderr, "ERROR: Unable to allocate memory\n");
+      return EXIT_FAILURE;
+   }
+
+   if (json) {
+      printf("{\"width\": %d, \"height\": %d, \"repeat\": %d, \"results\": [", W, H, repeat);
+   } else {
+      printf("%dx%d frame, %d repetitions (+%d warm-up)\n", W, H, repeat, WARMUP);
+      printf("%-10s %-8s %5s %10s %10s %10s %10s\n", "scene", "kernel", "n", "min ms", "median ms", "Mpix/s", "Giter/s");
+   }
+   const char *sep = "";
+   for (int i = 0; i < scenes_count; ++i) {
+      const scene_t *sc = &scenes[i];
+      const julia_params_dd p = { {sc->c_re, 0}, {sc->c_im, 0}, {sc->re, 0}, {sc->im, 0}, {sc->d_re, 0}, {sc->d_im, 0}, sc->n };
+      const julia_kernel k = kernel < 0 ? julia_select(&p, W, H) : kernel;
+      for (int r = 0; r < WARMUP; ++r) {
+         compute_frame(k, &p, frame);
+      }
+      for (int r = 0; r < repeat; ++r) {
+         double t0 = get_time();
+         compute_frame(k, &p, frame);
+         t[r] = get_time() - t0;
+      }
+      long iters = 0;
+      for (int k = 0; k < W * H; ++k) {
+         iters += frame[k];
+      }
+      qsort(t, repeat, sizeof(double), cmp_double);
+      const double median = repeat % 2 ? t[repeat / 2] : (t[repeat / 2 - 1] + t[repeat / 2]) / 2;
+      const double mpix = W * H / median * 1e-6;
+      const double giter = iters / median * 1e-9;
+      if (json) {
+         printf("%s\n   {\"scene\": \"%s\", \"kernel\": \"%s\", \"n\": %d, \"iterations\": %ld, \"ms_min\": %.3f, \"ms_median\": %.3f, \"mpix_per_s\": %.2f, \"giter_per_s\": %.3f}",
+               sep, sc->name, julia_kernel_name(k), sc->n, iters, t[0] * 1e3, median * 1e3, mpix, giter);
+         sep = ",";
+      } else {
+         printf("%-10s %-8s %5d %10.3f %10.3f %10.2f %10.3f\n", sc->name, julia_kernel_name(k), sc->n, t[0] * 1e3, median * 1e3, mpix, giter);
+      }
+   }
+   if (json) {
+      printf("\n]}\n");
+   }
+   free(frame);
+   free(t);
+   return EXIT_SUCCESS;
+}
+
+/* end of bench_julia.c */
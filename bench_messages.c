@@ -0,0 +1,287 @@
+/*
+ * Filename: bench_messages.c
+ * Date:     2026/10/19
+ *
+ * Microbenchmark of the messages.c codec - encode and decode throughput per
+ * message type over a large synthetic stream, without any pipe I/O.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "crc32c.h"
+#include "messages.h"
+
+#define DEFAULT_MESSAGES 1000000
+#define DEFAULT_REPEAT 15
+#define WARMUP 2
+
+typedef struct {
+   double min;
+   double median;
+   double mean;
+   double stddev;
+} stats_t;
+
+typedef double (*bench_fnc)(const message *msgs, uint8_t *stream, int count, int len);
+
+static volatile uint32_t sink; // keeps the results alive
+
+// - function -----------------------------------------------------------------
+static double get_time(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// - function -----------------------------------------------------------------
+static int cmp_double(const void *a, const void *b)
+{
+   double d = *(const double*)a - *(const double*)b;
+   return d < 0 ? -1 : (d > 0);
+}
+
+// - function -----------------------------------------------------------------
+static stats_t get_stats(double *v, int n)
+{
+   stats_t s = { 0 };
+   qsort(v, n, sizeof(double), cmp_double);
+   s.min = v[0];
+   s.median = n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+   for (int i = 0; i < n; ++i) {
+      s.mean += v[i];
+   }
+   s.mean /= n;
+   for (int i = 0; i < n; ++i) {
+      s.stddev += (v[i] - s.mean) * (v[i] - s.mean);
+   }
+   s.stddev = n > 1 ? sqrt(s.stddev / (n - 1)) : 0;
+   return s;
+}
+
+// - function -----------------------------------------------------------------
+static message random_message(uint8_t type)
+{
+   message msg = { .type = type };
+   switch (type) {
+      case MSG_VERSION:
+         msg.data.version = (msg_version){ rand() % 10, rand() % 10, rand() % 10 };
+         break;
+      case MSG_STARTUP:
+         memcpy(msg.data.startup.message, "PRG-SEM-2", STARTUP_MSG_LEN);
+         break;
+      case MSG_SET_COMPUTE:
+         msg.data.set_compute = (msg_set_compute){ rand() / (double)RAND_MAX, rand() / (double)RAND_MAX, 0.005, -0.0045, rand() % 256 };
+         break;
+      case MSG_COMPUTE:
+         msg.data.compute = (msg_compute){ rand() % 100, -1.6 + rand() / (double)RAND_MAX, 1.1 - rand() / (double)RAND_MAX, 64, 48 };
+         break;
+      case MSG_COMPUTE_DATA:
+         msg.data.compute_data = (msg_compute_data){ rand() % 100, rand() % 64, rand() % 48, rand() % 256 };
+         break;
+      case MSG_SET_COMPUTE_HP:
+         msg.data.set_compute_hp = (msg_set_compute_hp){ { rand() / (double)RAND_MAX, 1e-17 }, { rand() / (double)RAND_MAX, -1e-17 }, { 1e-15, 0 }, { -1e-15, 0 }, rand() % 256, rand() % 6 };
+         break;
+      case MSG_COMPUTE_DATA_PACKED:
+         msg.data.compute_data_packed = (msg_compute_data_packed){ rand() % 100, 64, 48, rand() % 3075 };
+         break;
+      case MSG_COMPUTE_HP:
+         msg.data.compute_hp = (msg_compute_hp){ rand() % 100, { -0.43 + rand() / (double)RAND_MAX, 1e-17 }, { 0.1, -1e-17 }, 64, 48 };
+         break;
+   }
+   return msg;
+}
+
+// - function -----------------------------------------------------------------
+static double bench_encode(const message *msgs, uint8_t *stream, int count, int len)
+{
+   int size;
+   uint8_t *p = stream;
+   uint8_t buf[sizeof(message)];
+   double t = get_time();
+   for (int i = 0; i < count; ++i) {
+      fill_message_buf(&msgs[i], buf, sizeof(message), &size);
+      memcpy(p, buf, size); // the same copy as the write() in send_message()
+      p += size;
+   }
+   t = get_time() - t;
+   sink += stream[count * len - 1];
+   return t;
+}
+
+// - function -----------------------------------------------------------------
+static double bench_encode_malloc(const message *msgs, uint8_t *stream, int count, int len)
+{
+   int size;
+   uint8_t *p = stream;
+   double t = get_time();
+   for (int i = 0; i < count; ++i) {
+      uint8_t *buf = malloc(sizeof(message));
+      fill_message_buf(&msgs[i], buf, sizeof(message), &size);
+      memcpy(p, buf, size);
+      p += size;
+      free(buf);
+   }
+   t = get_time() - t;
+   sink += stream[count * len - 1];
+   return t;
+}
+
+// - function -----------------------------------------------------------------
+static double bench_decode(const message *msgs, uint8_t *stream, int count, int len)
+{
+   uint32_t acc = 0;
+   message msg;
+   const uint8_t *p = stream;
+   double t = get_time();
+   for (int i = 0; i < count; ++i, p += len) {
+      acc += parse_message_buf(p, len, &msg);
+      acc += msg.data.compute_data.iter;
+   }
+   t = get_time() - t;
+   sink += acc;
+   return t;
+}
+
+// - function -----------------------------------------------------------------
+static double bench_decode_malloc(const message *msgs, uint8_t *stream, int count, int len)
+{
+   uint32_t acc = 0;
+   const uint8_t *p = stream;
+   double t = get_time();
+   for (int i = 0; i < count; ++i, p += len) {
+      message *msg = malloc(sizeof(message)); // as buffer_parse() does per message
+      acc += parse_message_buf(p, len, msg);
+      acc += msg->data.compute_data.iter;
+      free(msg);
+   }
+   t = get_time() - t;
+   sink += acc;
+   return t;
+}
+
+// - function -----------------------------------------------------------------
+static double bench_cksum(const message *msgs, uint8_t *stream, int count, int len)
+{
+   uint32_t acc = 0;
+   const uint8_t *p = stream;
+   double t = get_time();
+   for (int i = 0; i < count; ++i, p += len) {
+      uint8_t cksum = 0; // the same sum as parse_message_buf() does
+      for (int j = 0; j < len; ++j) {
+         cksum += p[j];
+      }
+      acc += cksum == 0xff;
+   }
+   t = get_time() - t;
+   sink += acc;
+   return t;
+}
+
+// - function -----------------------------------------------------------------
+static double bench_crc32c(const message *msgs, uint8_t *stream, int count, int len)
+{
+   // the whole stream at once, as a bulk payload is checked
+   double t = get_time();
+   sink += crc32c(0, stream, (size_t)count * len);
+   return get_time() - t;
+}
+
+// - function -----------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+   static const struct { uint8_t type; const char *name; } types[] = {
+      { MSG_COMPUTE_DATA, "compute_data" },
+      { MSG_COMPUTE_DATA_PACKED, "packed_header" },
+      { MSG_COMPUTE, "compute" },
+      { MSG_SET_COMPUTE, "set_compute" },
+      { MSG_COMPUTE_HP, "compute_hp" },
+      { MSG_SET_COMPUTE_HP, "set_compute_hp" },
+      { MSG_VERSION, "version" },
+      { MSG_STARTUP, "startup" },
+      { MSG_DONE, "done" },
+   };
+   static const struct { bench_fnc fnc; const char *name; } benches[] = {
+      { bench_encode, "encode" },
+      { bench_encode_malloc, "encode+malloc" },
+      { bench_decode, "decode" },
+      { bench_decode_malloc, "decode+malloc" },
+      { bench_cksum, "cksum" },
+      { bench_crc32c, "crc32c" },
+   };
+   int count = DEFAULT_MESSAGES;
+   int repeat = DEFAULT_REPEAT;
+   int json = 0;
+   int opt;
+   while ((opt = getopt(argc, argv, "n:r:j")) != -1) {
+      switch (opt) {
+         case 'n': count = atoi(optarg); break;
+         case 'r': repeat = atoi(optarg); break;
+         case 'j': json = 1; break;
+         default:
+            fprintf(stderr, "usage: %s [-n messages] [-r repetitions] [-j]\n", argv[0]);
+            return EXIT_FAILURE;
+      }
+   }
+   if (count < 1 || repeat < 1) {
+      fprintf(stderr, "ERROR: Number of messages and repetitions must be positive\n");
+      return EXIT_FAILURE;
+   }
+
+   message *msgs = malloc(count * sizeof(message));
+   uint8_t *stream = malloc((size_t)count * sizeof(message));
+   double *t = malloc(repeat * sizeof(double));
+   if (!msgs || !stream || !t) {
+      fprintf(stderr, "ERROR: Unable to allocate memory\n");
+      return EXIT_FAILURE;
+   }
+
+   if (json) {
+      printf("{\"messages\": %d, \"repeat\": %d, \"results\": [", count, repeat);
+   } else {
+      printf("%d messages, %d repetitions (+%d warm-up), ns per message\n", count, repeat, WARMUP);
+      printf("%-14s %-14s %8s %8s %8s %8s %10s %8s\n", "type", "bench", "min", "median", "mean", "stddev", "Mmsg/s", "MB/s");
+   }
+   srand(1);
+   const char *sep = "";
+   for (int i = 0; i < sizeof(types) / sizeof(types[0]); ++i) {
+      int len;
+      get_message_size(types[i].type, &len);
+      for (int k = 0; k < count; ++k) {
+         msgs[k] = random_message(types[i].type);
+      }
+      bench_encode(msgs, stream, count, len); // stream for the decoders
+      for (int b = 0; b < sizeof(benches) / sizeof(benches[0]); ++b) {
+         for (int r = 0; r < WARMUP; ++r) {
+            benches[b].fnc(msgs, stream, count, len);
+         }
+         for (int r = 0; r < repeat; ++r) {
+            t[r] = benches[b].fnc(msgs, stream, count, len) * 1e9 / count;
+         }
+         stats_t s = get_stats(t, repeat);
+         const double mmsgs = 1e3 / s.median;
+         if (json) {
+            printf("%s\n   {\"type\": \"%s\", \"bench\": \"%s\", \"bytes\": %d, \"ns_min\": %.3f, \"ns_median\": %.3f, \"ns_mean\": %.3f, \"ns_stddev\": %.3f, \"mmsg_per_s\": %.3f, \"mb_per_s\": %.1f}",
+                  sep, types[i].name, benches[b].name, len, s.min, s.median, s.mean, s.stddev, mmsgs, mmsgs * len);
+            sep = ",";
+         } else {
+            printf("%-14s %-14s %8.2f %8.2f %8.2f %8.2f %10.2f %8.1f\n", types[i].name, benches[b].name, s.min, s.median, s.mean, s.stddev, mmsgs, mmsgs * len);
+         }
+      }
+   }
+   if (json) {
+      printf("\n]}\n");
+   }
+   free(msgs);
+   free(stream);
+   free(t);
+   return EXIT_SUCCESS;
+}
+
+/* end of bench_messages.c */
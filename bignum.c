@@ -0,0 +1,111 @@
+/*
+ * Filename: bignum.c
+ * Date:     2026/10/19
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "bignum.h"
+
+// - function -----------------------------------------------------------------
+static int mag_cmp(const bignum *a, const bignum *b, int n)
+{
+   for (int i = 0; i < n; ++i) {
+      if (a->d[i] != b->d[i]) {
+         return a->d[i] < b->d[i] ? -1 : 1;
+      }
+   }
+   return 0;
+}
+
+// - function -----------------------------------------------------------------
+static void mag_add(bignum *r, const bignum *a, const bignum *b, int n)
+{
+   uint64_t carry = 0;
+   for (int i = n - 1; i >= 0; --i) {
+      const uint64_t t = (uint64_t)a->d[i] + b->d[i] + carry;
+      r->d[i] = (uint32_t)t;
+      carry = t >> 32;
+   }
+}
+
+// - function -----------------------------------------------------------------
+static void mag_sub(bignum *r, const bignum *a, const bignum *b, int n) // |a| >= |b|
+{
+   int64_t borrow = 0;
+   for (int i = n - 1; i >= 0; --i) {
+      int64_t t = (int64_t)a->d[i] - b->d[i] - borrow;
+      borrow = t < 0;
+      r->d[i] = (uint32_t)(t + (borrow << 32));
+   }
+}
+
+// - function -----------------------------------------------------------------
+void bn_from_double(bignum *r, double x, int n)
+{
+   memset(r, 0, sizeof(bignum));
+   r->neg = x < 0;
+   x = fabs(x);
+   for (int i = 0; i < n; ++i) { // every step is exact in double
+      const double limb = floor(x);
+      r->d[i] = (uint32_t)limb;
+      x = (x - limb) * 0x1p32;
+   }
+}
+
+// - function -----------------------------------------------------------------
+double bn_to_double(const bignum *a, int n)
+{
+   double r = 0;
+   for (int i = n - 1; i >= 0; --i) {
+      r = r * 0x1p-32 + a->d[i];
+   }
+   return a->neg ? -r : r;
+}
+
+// - function -----------------------------------------------------------------
+void bn_add(bignum *r, const bignum *a, const bignum *b, int n)
+{
+   if (a->neg == b->neg) {
+      r->neg = a->neg;
+      mag_add(r, a, b, n);
+   } else if (mag_cmp(a, b, n) >= 0) {
+      r->neg = a->neg;
+      mag_sub(r, a, b, n);
+   } else {
+      r->neg = b->neg;
+      mag_sub(r, b, a, n);
+   }
+}
+
+// - function -----------------------------------------------------------------
+void bn_sub(bignum *r, const bignum *a, const bignum *b, int n)
+{
+   bignum nb = *b;
+   nb.neg = !b->neg;
+   bn_add(r, a, &nb, n);
+}
+
+// - function -----------------------------------------------------------------
+void bn_mul(bignum *r, const bignum *a, const bignum *b, int n)
+{
+   // schoolbook from the least significant row; the limb of 2^-32(i + j) is
+   // acc[i + j + 1], acc[i] is still untouched when the carry of row i comes
+   uint64_t acc[2 * BN_LIMBS + 1] = { 0 };
+   for (int i = n - 1; i >= 0; --i) {
+      uint64_t carry = 0;
+      for (int j = n - 1; j >= 0; --j) {
+         const uint64_t t = acc[i + j + 1] + (uint64_t)a->d[i] * b->d[j] + carry;
+         acc[i + j + 1] = t & 0xffffffffu;
+         carry = t >> 32;
+      }
+      acc[i] = carry;
+   }
+   r->neg = a->neg != b->neg;
+   for (int i = 0; i < n; ++i) {
+      r->d[i] = (uint32_t)acc[i + 1];
+   }
+}
+
+/* end of bignum.c */
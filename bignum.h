@@ -0,0 +1,45 @@
+/*
+ * Filename: bignum.h
+ * Date:     2026/10/19
+ *
+ * Small fixed-point bignum of libjulia for the perturbation reference orbit.
+ * The value is d[0] + d[1] * 2^-32 + ... + d[n - 1] * 2^-32(n - 1) with the
+ * sign aside, n limbs are used (at most BN_LIMBS); only values below 2^32 in
+ * magnitude are representable, which is plenty for |z| <= 2 of the orbit.
+ */
+
+#ifndef __BIGNUM_H__
+#define __BIGNUM_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define BN_LIMBS 16   // 480 fraction bits
+
+typedef struct {
+   bool neg;
+   uint32_t d[BN_LIMBS];  // d[0] integer part, then the fraction, most significant first
+} bignum;
+
+/// ----------------------------------------------------------------------------
+/// @brief bn_from_double -- exact up to the precision of n limbs
+/// ----------------------------------------------------------------------------
+void bn_from_double(bignum *r, double x, int n);
+
+/// ----------------------------------------------------------------------------
+/// @brief bn_to_double -- within one ulp (the limbs are summed in double)
+/// ----------------------------------------------------------------------------
+double bn_to_double(const bignum *a, int n);
+
+void bn_add(bignum *r, const bignum *a, const bignum *b, int n);
+
+void bn_sub(bignum *r, const bignum *a, const bignum *b, int n);
+
+/// ----------------------------------------------------------------------------
+/// @brief bn_mul -- r = a * b truncated to n limbs, r may alias a or b
+/// ----------------------------------------------------------------------------
+void bn_mul(bignum *r, const bignum *a, const bignum *b, int n);
+
+#endif
+
+/* end of bignum.h */
@@ -0,0 +1,284 @@
+/*
+ * Filename: capture.c
+ * Date:     2026/10/19
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include "capture.h"
+#include "messages.h"
+
+#define CAPTURE_HEADER 13 // direction, time, length
+#define CAPTURE_BUF 65536
+
+struct capture {
+   FILE *f;
+   pthread_mutex_t mtx;
+   uint64_t t0;
+   uint64_t t;        // start of the pending read record
+   int len;           // bytes of the pending read record
+   uint8_t buf[CAPTURE_BUF];
+};
+
+struct replay {
+   FILE *f;
+   bool paced;
+   int rx;            // write end of the stream read by the UI
+   int tx;            // read end of the requests of the UI
+   pthread_t thread;
+};
+
+static void *replay_thread(void *d);
+
+// - function -----------------------------------------------------------------
+static uint64_t now_ns(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// - function -----------------------------------------------------------------
+static void put_le(uint8_t *p, uint64_t v, int n)
+{
+   for (int i = 0; i < n; ++i) {
+      p[i] = v >> (8 * i);
+   }
+}
+
+// - function -----------------------------------------------------------------
+static uint64_t get_le(const uint8_t *p, int n)
+{
+   uint64_t v = 0;
+   for (int i = n - 1; i >= 0; --i) {
+      v = v << 8 | p[i];
+   }
+   return v;
+}
+
+// - function -----------------------------------------------------------------
+static void put_record(FILE *f, char dir, uint64_t t, const uint8_t *buf, int len)
+{
+   uint8_t hdr[CAPTURE_HEADER] = { dir };
+   put_le(hdr + 1, t, 8);
+   put_le(hdr + 9, len, 4);
+   fwrite(hdr, 1, sizeof(hdr), f);
+   fwrite(buf, 1, len, f);
+}
+
+// - function -----------------------------------------------------------------
+static void flush_pending(capture *c)
+{
+   if (c->len > 0) {
+      put_record(c->f, CAPTURE_READ, c->t, c->buf, c->len);
+      c->len = 0;
+   }
+}
+
+// - function -----------------------------------------------------------------
+capture *capture_open(const char *fname)
+{
+   capture *c = calloc(1, sizeof(capture));
+   if (c == NULL || (c->f = fopen(fname, "wb")) == NULL) {
+      free(c);
+      return NULL;
+   }
+   fwrite(CAPTURE_MAGIC, 1, strlen(CAPTURE_MAGIC), c->f);
+   pthread_mutex_init(&c->mtx, NULL);
+   c->t0 = now_ns();
+   return c;
+}
+
+// - function -----------------------------------------------------------------
+void capture_add(capture *c, char dir, const uint8_t *buf, int len)
+{
+   if (c == NULL || len <= 0) {
+      return;
+   }
+   pthread_mutex_lock(&c->mtx);
+   const uint64_t t = now_ns() - c->t0;
+   // the single bytes of the plain stream are merged, a record per byte would be 14 times larger
+   if (dir != CAPTURE_READ || t - c->t > CAPTURE_MERGE_NS || c->len + len > CAPTURE_BUF) {
+      flush_pending(c);
+   }
+   if (dir != CAPTURE_READ || len > CAPTURE_BUF) {
+      put_record(c->f, dir, t, buf, len);
+   } else {
+      if (c->len == 0) {
+         c->t = t;
+      }
+      memcpy(c->buf + c->len, buf, len);
+      c->len += len;
+   }
+   pthread_mutex_unlock(&c->mtx);
+}
+
+// - function -----------------------------------------------------------------
+void capture_close(capture *c)
+{
+   if (c == NULL) {
+      return;
+   }
+   flush_pending(c);
+   fclose(c->f);
+   pthread_mutex_destroy(&c->mtx);
+   free(c);
+}
+
+// - function -----------------------------------------------------------------
+replay *replay_start(const char *fname, bool paced, int *rd, int *fd)
+{
+   char magic[sizeof(CAPTURE_MAGIC)] = { 0 };
+   replay *r = calloc(1, sizeof(replay));
+   if (r == NULL || (r->f = fopen(fname, "rb")) == NULL) {
+      free(r);
+      return NULL;
+   }
+   int rx[2];
+   int tx[2];
+   if (fread(magic, 1, strlen(CAPTURE_MAGIC), r->f) != strlen(CAPTURE_MAGIC) || strcmp(magic, CAPTURE_MAGIC)) {
+      fprintf(stderr, "\033[1;31mERROR\033[0m: %s is not a capture\n", fname);
+   } else if (pipe(rx) == 0) {
+      if (pipe(tx) == 0) {
+         r->paced = paced;
+         r->rx = rx[1];
+         r->tx = tx[0];
+         *rd = rx[0];
+         *fd = tx[1];
+         if (pthread_create(&r->thread, NULL, replay_thread, r) == 0) {
+            return r;
+         }
+         close(tx[0]);
+         close(tx[1]);
+      }
+      close(rx[0]);
+      close(rx[1]);
+   }
+   fclose(r->f);
+   free(r);
+   return NULL;
+}
+
+// - function -----------------------------------------------------------------
+void replay_finish(replay *r)
+{
+   if (r == NULL) {
+      return;
+   }
+   pthread_join(r->thread, NULL);
+   fclose(r->f);
+   free(r);
+}
+
+// - function -----------------------------------------------------------------
+static bool read_all(int fd, uint8_t *buf, int len)
+{
+   for (int i = 0; i < len; ) {
+      const ssize_t n = read(fd, buf + i, len - i);
+      if (n < 0 && errno == EINTR) {
+         continue;
+      }
+      if (n <= 0) {
+         return false;
+      }
+      i += n;
+   }
+   return true;
+}
+
+// - function -----------------------------------------------------------------
+static bool write_all(int fd, const uint8_t *buf, int len)
+{
+   for (int i = 0; i < len; ) {
+      const ssize_t n = write(fd, buf + i, len - i);
+      if (n < 0 && errno == EINTR) {
+         continue;
+      }
+      if (n <= 0) {
+         return false;
+      }
+      i += n;
+   }
+   return true;
+}
+
+// - function -----------------------------------------------------------------
+static bool wait_request(replay *r, uint8_t type)
+{
+   // the other requests (e.g., one more MSG_GET_VERSION than recorded) are dropped
+   uint8_t buf[sizeof(message)];
+   int size;
+   do {
+      if (!read_all(r->tx, buf, 1)) {
+         return false;
+      }
+      if (get_message_size(buf[0], &size) && !read_all(r->tx, buf + 1, size - 1)) {
+         return false;
+      }
+   } while (buf[0] != type);
+   return true;
+}
+
+// - function -----------------------------------------------------------------
+static void *replay_thread(void *d)
+{
+   replay *r = (replay*)d;
+   sigset_t set;
+   sigemptyset(&set);
+   sigaddset(&set, SIGPIPE); // the UI may close the stream first, write fails by EPIPE
+   pthread_sigmask(SIG_BLOCK, &set, NULL);
+   uint8_t *buf = malloc(CAPTURE_BUF);
+   int size = CAPTURE_BUF;
+   uint64_t base = now_ns();
+   uint8_t hdr[CAPTURE_HEADER];
+   while (buf && fread(hdr, 1, sizeof(hdr), r->f) == sizeof(hdr)) {
+      const uint64_t t = get_le(hdr + 1, 8);
+      const int len = get_le(hdr + 9, 4);
+      if (len > size) {
+         uint8_t *b = realloc(buf, len);
+         if (b == NULL) {
+            break;
+         }
+         buf = b;
+         size = len;
+      }
+      if (len <= 0 || fread(buf, 1, len, r->f) != len) {
+         break;
+      }
+      if (hdr[0] == CAPTURE_WRITE) {
+         if (!wait_request(r, buf[0])) {
+            break;
+         }
+         const uint64_t now = now_ns();
+         if (now > base + t) { // the UI asked later than in the record, keep the pace after it
+            base = now - t;
+         }
+      } else {
+         if (r->paced) {
+            const uint64_t now = now_ns();
+            if (base + t > now) {
+               const uint64_t dt = base + t - now;
+               nanosleep(&(struct timespec){ dt / 1000000000u, dt % 1000000000u }, NULL);
+            }
+         }
+         if (!write_all(r->rx, buf, len)) {
+            break;
+         }
+      }
+   }
+   free(buf);
+   close(r->rx); // end of the stream
+   while (wait_request(r, MSG_NBR)) { } // drain the UI requests until it closes its end
+   close(r->tx);
+   return NULL;
+}
+
+/* end of capture.c */
@@ -0,0 +1,65 @@
+/*
+ * Filename: capture.h
+ * Date:     2026/10/19
+ *
+ * Record of the module stream for reproducible benchmarks of the UI side.
+ * A capture holds everything read from the module and the requests that
+ * caused it, with their times; the replay feeds it back through a pipe, so
+ * prgsem-main decodes, colours and blits it by the same code as a live run.
+ */
+
+#ifndef __CAPTURE_H__
+#define __CAPTURE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CAPTURE_MAGIC "PRGCAP1\n"
+#define CAPTURE_READ 'R'   // bytes read from the module
+#define CAPTURE_WRITE 'W'  // one request sent to the module
+#define CAPTURE_MERGE_NS 1000000 // reads within 1 ms share one record
+
+typedef struct capture capture;
+typedef struct replay replay;
+
+/// ----------------------------------------------------------------------------
+/// @brief capture_open -- start a capture into fname
+///
+/// File: CAPTURE_MAGIC, then the records [direction][ns since the start,
+/// 64 bit][length, 32 bit][bytes], all little endian.
+/// @return NULL on error
+/// ----------------------------------------------------------------------------
+capture *capture_open(const char *fname);
+
+/// ----------------------------------------------------------------------------
+/// @brief capture_add -- append len bytes in the direction CAPTURE_READ or
+/// CAPTURE_WRITE, thread safe; c may be NULL
+/// ----------------------------------------------------------------------------
+void capture_add(capture *c, char dir, const uint8_t *buf, int len);
+
+/// ----------------------------------------------------------------------------
+/// @brief capture_close -- flush and close the capture, c may be NULL
+/// ----------------------------------------------------------------------------
+void capture_close(capture *c);
+
+/// ----------------------------------------------------------------------------
+/// @brief replay_start -- play fname back in place of the module
+///
+/// The reads of the capture come out of *rd. A recorded request is
+/// waited for until the UI writes a request of the same type into *fd, so
+/// the answers never come before the UI has asked for them.
+/// @param paced -- keep the recorded time between the reads, otherwise as
+///                 fast as the UI reads them
+/// @return NULL on error
+/// ----------------------------------------------------------------------------
+replay *replay_start(const char *fname, bool paced, int *rd, int *fd);
+
+/// ----------------------------------------------------------------------------
+/// @brief replay_finish -- wait for the end of the replay and free it, the UI
+/// has to close its *fd first; r may be NULL
+/// ----------------------------------------------------------------------------
+void replay_finish(replay *r);
+
+#endif
+
+/* end of capture.h */
@@ -30,7 +30,7 @@ message *buffer_parse(data_t *data, int message_type){
 bool send_message(data_t *data, message *msg, int pipe){
    uint8_t msg_buf[sizeof(message)];
    int size;
-   int ret;
+   int ret = -1;
    fill_message_buf(msg, msg_buf,sizeof(message), &size);
    pthread_mutex_lock(data->mtx);
    if (pipe == RD){ret = write(data->rd, msg_buf, size);}
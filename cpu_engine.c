@@ -0,0 +1,385 @@
+/*
+ * Filename: cpu_engine.c
+ * Date:     2026/10/19
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "affinity.h"
+#include "cpu_engine.h"
+#include "histo.h"
+#include "trace.h"
+
+#define CPU_MAX_THREADS 64
+#define CPU_COST_SAMPLES 4 // pixels per side of a chunk computed by the cost pre-pass
+
+typedef struct { // the chunk of a worker, its rows are claimed by the idle workers too
+   uint64_t claim;   // (cid + 1) << 32 | the next row, 0 without a chunk (atomic)
+   int done;         // rows computed (atomic)
+   uint64_t work_ns; // compute time of the rows (atomic)
+   uint8_t *buf;     // cw * ch, the rows of the chunk
+} cpu_slot;
+
+struct cpu_engine {
+   julia_params_dd p;
+   julia_kernel kernel;
+   julia_orbit *orbit; // JULIA_PERTURB reference at the frame centre, read only
+   int w;
+   int h;
+   int cw;
+   int ch;
+   int n_re;         // chunks in a row
+   int chunks;
+   uint8_t *iters;
+   scheduler *sched;
+   int running;      // workers still alive
+   bool abort;
+   uint8_t *ready;   // chunk kept, set by the worker (release)
+   uint8_t *polled;  // chunk reported by cpu_poll, consumer only
+   double *chunk_s;  // compute time of the kept chunks, published by ready
+   double *taken_s;  // when a worker took the kept chunks, published by ready
+   int busy;         // workers computing a chunk (atomic)
+   int started;      // index of the next worker, its place in affinity_pin() (atomic)
+   int first;        // all chunks below are reported
+   bool mirror;      // pixel (x, y) mirrors (ox - x, oy - y), see julia_mirror()
+   int ox;
+   int oy;
+   long mirrored;    // pixels copied instead of computed
+   double prepass_s;
+   uint64_t work_ns; // all the rows (atomic)
+   long helped;      // rows computed for another worker (atomic)
+   int threads;
+   pthread_t thread[CPU_MAX_THREADS];
+   cpu_slot slot[CPU_MAX_THREADS];
+};
+
+static void* cpu_worker(void *d);
+static void estimate_cost(cpu_engine *e, double *cost);
+static void compute_row(cpu_engine *e, int x0, int y, int w, uint8_t *out);
+
+// - function -----------------------------------------------------------------
+cpu_engine *cpu_start(const julia_params_dd *p, julia_kernel kernel, int w, int h, int cw, int ch, uint8_t *iters, int threads, scheduler *sched)
+{
+   if (threads <= 0) {
+      threads = affinity_workers(); // the compute cpus of the placement, if any
+   }
+   if (threads <= 0) {
+      threads = sysconf(_SC_NPROCESSORS_ONLN);
+   }
+   threads = threads < 1 ? 1 : (threads > CPU_MAX_THREADS ? CPU_MAX_THREADS : threads);
+   cpu_engine *e = calloc(1, sizeof(cpu_engine));
+   if (e == NULL) {
+      return NULL;
+   }
+   e->p = *p;
+   e->kernel = kernel;
+   e->w = w;
+   e->h = h;
+   e->cw = cw;
+   e->ch = ch;
+   e->mirror = julia_mirror(p, &e->ox, &e->oy);
+   e->n_re = (w + cw - 1) / cw;
+   e->chunks = e->n_re * ((h + ch - 1) / ch);
+   e->iters = iters;
+   e->sched = sched;
+   e->ready = calloc(e->chunks, 1);
+   e->polled = calloc(e->chunks, 1);
+   e->chunk_s = calloc(e->chunks, sizeof(double));
+   e->taken_s = calloc(e->chunks, sizeof(double));
+   if (kernel == JULIA_PERTURB) {
+      e->orbit = julia_orbit_create(p, julia_coord(p->re, p->d_re, w / 2), julia_coord(p->im, p->d_im, h / 2));
+   }
+   double *cost = calloc(e->chunks, sizeof(double));
+   bool ok = e->ready && e->polled && e->chunk_s && e->taken_s && cost && (kernel != JULIA_PERTURB || e->orbit);
+   for (int i = 0; ok && i < threads; ++i) {
+      ok = (e->slot[i].buf = malloc(cw * ch)) != NULL;
+   }
+   if (!ok) {
+      fprintf(stderr, "\033[1;31mERROR\033[0m: Unable to allocate the cpu engine\r\n");
+      julia_orbit_free(e->orbit);
+      for (int i = 0; i < threads; ++i) {
+         free(e->slot[i].buf);
+      }
+      free(e->ready);
+      free(e->polled);
+      free(e->chunk_s);
+      free(e->taken_s);
+      free(cost);
+      free(e);
+      return NULL;
+   }
+   const uint64_t t0 = histo_now();
+   estimate_cost(e, cost);
+   sched_set_cost(sched, cost); // the order of the remote module too in the hybrid mode
+   e->prepass_s = (histo_now() - t0) * 1e-9;
+   free(cost);
+   e->running = threads;
+   for (int i = 0; i < threads; ++i) {
+      if (pthread_create(&e->thread[i], NULL, cpu_worker, e) != 0) {
+         __atomic_fetch_sub(&e->running, threads - i, __ATOMIC_RELEASE);
+         break;
+      }
+      e->threads += 1;
+   }
+   return e;
+}
+
+// - function -----------------------------------------------------------------
+int cpu_poll(cpu_engine *e, int *cids, int max)
+{
+   int n = 0;
+   for (int cid = e->first; cid < e->chunks && n < max; ++cid) {
+      if (!e->polled[cid] && __atomic_load_n(&e->ready[cid], __ATOMIC_ACQUIRE)) {
+         e->polled[cid] = 1;
+         cids[n++] = cid;
+      }
+      if (cid == e->first && e->polled[cid]) {
+         e->first += 1;
+      }
+   }
+   return n;
+}
+
+// - function -----------------------------------------------------------------
+void cpu_abort(cpu_engine *e)
+{
+   __atomic_store_n(&e->abort, true, __ATOMIC_RELAXED);
+}
+
+// - function -----------------------------------------------------------------
+bool cpu_running(cpu_engine *e)
+{
+   return __atomic_load_n(&e->running, __ATOMIC_ACQUIRE) > 0;
+}
+
+// - function -----------------------------------------------------------------
+int cpu_busy(cpu_engine *e)
+{
+   return __atomic_load_n(&e->busy, __ATOMIC_RELAXED);
+}
+
+// - function -----------------------------------------------------------------
+double cpu_chunk_time(cpu_engine *e, int cid)
+{
+   return e->chunk_s[cid];
+}
+
+// - function -----------------------------------------------------------------
+double cpu_chunk_taken(cpu_engine *e, int cid)
+{
+   return e->taken_s[cid];
+}
+
+// - function -----------------------------------------------------------------
+void cpu_finish(cpu_engine *e)
+{
+   if (e == NULL) {
+      return;
+   }
+   cpu_abort(e);
+   for (int i = 0; i < e->threads; ++i) {
+      pthread_join(e->thread[i], NULL);
+   }
+   julia_orbit_free(e->orbit);
+   for (int i = 0; i < CPU_MAX_THREADS; ++i) {
+      free(e->slot[i].buf);
+   }
+   free(e->ready);
+   free(e->polled);
+   free(e->chunk_s);
+   free(e->taken_s);
+   free(e);
+}
+
+// - function -----------------------------------------------------------------
+void cpu_get_stats(cpu_engine *e, cpu_stats *st)
+{
+   st->threads = e->threads;
+   st->prepass_s = e->prepass_s;
+   st->work_s = __atomic_load_n(&e->work_ns, __ATOMIC_RELAXED) * 1e-9;
+   st->rows_helped = __atomic_load_n(&e->helped, __ATOMIC_RELAXED);
+}
+
+// - function -----------------------------------------------------------------
+// compute the row of the chunk into the buffer of its slot, true if claimed
+static bool claim_row(cpu_engine *e, cpu_slot *slot, uint64_t claim)
+{
+   const int cid = (int)(claim >> 32) - 1;
+   const int row = (int)(claim & 0xffffffff);
+   const int x0 = (cid % e->n_re) * e->cw;
+   const int y0 = (cid / e->n_re) * e->ch;
+   const int w = x0 + e->cw <= e->w ? e->cw : e->w - x0;
+   const int h = y0 + e->ch <= e->h ? e->ch : e->h - y0;
+   if (cid < 0 || row >= h || !__atomic_compare_exchange_n(&slot->claim, &claim, claim + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+      return false;
+   }
+   const uint64_t t0 = histo_now();
+   compute_row(e, x0, y0 + row, w, slot->buf + row * e->cw);
+   const uint64_t dt = histo_now() - t0;
+   __atomic_fetch_add(&slot->work_ns, dt, __ATOMIC_RELAXED);
+   __atomic_fetch_add(&e->work_ns, dt, __ATOMIC_RELAXED);
+   __atomic_fetch_add(&slot->done, 1, __ATOMIC_RELEASE);
+   return true;
+}
+
+// - function -----------------------------------------------------------------
+// one row of the chunk of another worker with the most rows left, false if
+// there is none
+static bool help(cpu_engine *e, int me)
+{
+   cpu_slot *best = NULL;
+   uint64_t best_claim = 0;
+   int left = 0;
+   for (int i = 0; i < CPU_MAX_THREADS; ++i) { // e->threads grows while the workers start
+      const uint64_t claim = __atomic_load_n(&e->slot[i].claim, __ATOMIC_ACQUIRE);
+      const int cid = (int)(claim >> 32) - 1;
+      if (i == me || cid < 0) {
+         continue;
+      }
+      const int y0 = (cid / e->n_re) * e->ch;
+      const int rows = (y0 + e->ch <= e->h ? e->ch : e->h - y0) - (int)(claim & 0xffffffff);
+      if (rows > left) {
+         left = rows;
+         best = &e->slot[i];
+         best_claim = claim;
+      }
+   }
+   if (best && claim_row(e, best, best_claim)) {
+      __atomic_fetch_add(&e->helped, 1, __ATOMIC_RELAXED);
+   }
+   return best != NULL; // the claim may have been lost to another worker, look again
+}
+
+// - function -----------------------------------------------------------------
+static void* cpu_worker(void *d)
+{
+   cpu_engine *e = (cpu_engine*)d;
+   trace_thread("cpu worker");
+   const int me = __atomic_fetch_add(&e->started, 1, __ATOMIC_RELAXED);
+   cpu_slot *slot = &e->slot[me];
+   affinity_pin(AFFINITY_COMPUTE, me, "cpu worker");
+   while (!__atomic_load_n(&e->abort, __ATOMIC_RELAXED)) {
+      int cid = sched_take(e->sched, SCHED_LOCAL);
+      if (cid < 0 || cid >= e->chunks) {
+         if (help(e, me)) { // nothing to take, split the chunks of the others
+            continue;
+         }
+         break;
+      }
+      __atomic_fetch_add(&e->busy, 1, __ATOMIC_RELAXED);
+      struct timespec taken;
+      clock_gettime(CLOCK_MONOTONIC, &taken);
+      const int x0 = (cid % e->n_re) * e->cw;
+      const int y0 = (cid / e->n_re) * e->ch;
+      const int w = x0 + e->cw <= e->w ? e->cw : e->w - x0;
+      const int h = y0 + e->ch <= e->h ? e->ch : e->h - y0;
+      const uint64_t s0 = TRACE_BEGIN();
+      const uint64_t t0 = histo_now();
+      __atomic_store_n(&slot->done, 0, __ATOMIC_RELAXED);
+      __atomic_store_n(&slot->work_ns, 0, __ATOMIC_RELAXED);
+      __atomic_store_n(&slot->claim, (uint64_t)(cid + 1) << 32, __ATOMIC_RELEASE); // the rows are open to the others
+      uint64_t claim;
+      while (claim_row(e, slot, claim = __atomic_load_n(&slot->claim, __ATOMIC_RELAXED)) || (int)(claim & 0xffffffff) < h) {
+         // a lost claim is retried, the loop ends when all the rows are taken
+      }
+      while (__atomic_load_n(&slot->done, __ATOMIC_ACQUIRE) < h) {
+         sched_yield(); // a helper finishes its last row
+      }
+      __atomic_store_n(&slot->claim, 0, __ATOMIC_RELAXED);
+      HISTO_ADD(STAGE_COMPUTE, histo_now() - t0);
+      TRACE_END("chunk compute", s0, cid);
+      if (sched_finish(e->sched, cid, SCHED_LOCAL)) { // the remote module may have been faster
+         for (int y = 0; y < h; ++y) {
+            memcpy(e->iters + (size_t)(y0 + y) * e->w + x0, slot->buf + y * e->cw, w);
+         }
+         e->chunk_s[cid] = __atomic_load_n(&slot->work_ns, __ATOMIC_RELAXED) * 1e-9;
+         e->taken_s[cid] = taken.tv_sec + taken.tv_nsec * 1e-9;
+         sched_set_work(e->sched, cid, e->chunk_s[cid]);
+         __atomic_store_n(&e->ready[cid], 1, __ATOMIC_RELEASE);
+      }
+      __atomic_fetch_sub(&e->busy, 1, __ATOMIC_RELAXED);
+   }
+   __atomic_fetch_sub(&e->running, 1, __ATOMIC_RELEASE);
+   return NULL;
+}
+
+// - function -----------------------------------------------------------------
+static void estimate_cost(cpu_engine *e, double *cost)
+{
+   // a sampled pixel costs its iterations; a pixel whose mirror comes earlier
+   // in the frame costs nothing, it is copied once the mirror chunk is kept
+   for (int cid = 0; cid < e->chunks; ++cid) {
+      const int x0 = (cid % e->n_re) * e->cw;
+      const int y0 = (cid / e->n_re) * e->ch;
+      const int w = x0 + e->cw <= e->w ? e->cw : e->w - x0;
+      const int h = y0 + e->ch <= e->h ? e->ch : e->h - y0;
+      double sum = 0;
+      for (int j = 0; j < CPU_COST_SAMPLES; ++j) {
+         for (int i = 0; i < CPU_COST_SAMPLES; ++i) {
+            const int x = x0 + (2 * i + 1) * w / (2 * CPU_COST_SAMPLES);
+            const int y = y0 + (2 * j + 1) * h / (2 * CPU_COST_SAMPLES);
+            const int mx = e->ox - x;
+            const int my = e->oy - y;
+            if (e->mirror && mx >= 0 && mx < e->w && my >= 0 && my < e->h && (size_t)my * e->w + mx < (size_t)y * e->w + x) {
+               continue;
+            }
+            uint8_t it;
+            julia_compute_kernel(e->kernel, &e->p, e->orbit, x, y, 1, 1, &it, 1);
+            sum += 1.0 + it;
+         }
+      }
+      cost[cid] = sum * w * h / (CPU_COST_SAMPLES * CPU_COST_SAMPLES);
+   }
+}
+
+// - function -----------------------------------------------------------------
+static inline bool mirror_ready(cpu_engine *e, int x, int y)
+{
+   const int mx = e->ox - x;
+   const int my = e->oy - y;
+   if (!e->mirror || mx < 0 || mx >= e->w || my < 0 || my >= e->h) {
+      return false;
+   }
+   return __atomic_load_n(&e->ready[(my / e->ch) * e->n_re + mx / e->cw], __ATOMIC_ACQUIRE);
+}
+
+// - function -----------------------------------------------------------------
+static void compute_row(cpu_engine *e, int x0, int y, int w, uint8_t *out)
+{
+   // runs of pixels whose mirror is in a kept chunk are copied from the frame,
+   // the other runs computed; the ready flags only change from 0 to 1, so a
+   // run is at worst computed needlessly
+   int x = 0;
+   while (x < w) {
+      const bool mirrored = mirror_ready(e, x0 + x, y);
+      int run = 1;
+      while (x + run < w && mirror_ready(e, x0 + x + run, y) == mirrored) {
+         ++run;
+      }
+      if (mirrored) {
+         const uint8_t *src = e->iters + (size_t)(e->oy - y) * e->w + e->ox - x0 - x;
+         for (int i = 0; i < run; ++i) {
+            out[x + i] = src[-i];
+         }
+         __atomic_fetch_add(&e->mirrored, run, __ATOMIC_RELAXED);
+      } else {
+         julia_compute_kernel(e->kernel, &e->p, e->orbit, x0 + x, y, run, 1, out + x, run);
+      }
+      x += run;
+   }
+}
+
+// - function -----------------------------------------------------------------
+long cpu_mirrored(cpu_engine *e)
+{
+   return __atomic_load_n(&e->mirrored, __ATOMIC_RELAXED);
+}
+
+/* end of cpu_engine.c */
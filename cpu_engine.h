@@ -0,0 +1,111 @@
+/*
+ * Filename: cpu_engine.h
+ * Date:     2026/10/19
+ *
+ * Local (in-process) compute of the frame - worker threads take chunks from
+ * the scheduler and fill the iteration grid directly with libjulia, no
+ * messages are involved.
+ */
+
+#ifndef __CPU_ENGINE_H__
+#define __CPU_ENGINE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "julia.h"
+#include "scheduler.h"
+
+typedef struct cpu_engine cpu_engine;
+
+typedef struct {
+   int threads;
+   double prepass_s;  // the cost pre-pass of cpu_start()
+   double work_s;     // compute time of all the workers, the rows of the chunks
+   long rows_helped;  // rows computed for a chunk of another worker
+} cpu_stats;
+
+/// ----------------------------------------------------------------------------
+/// @brief cpu_start -- start computing the frame in the background
+///
+/// @param p        -- frame parameters, pixel (0, 0) is p->re, p->im
+/// @param kernel   -- libjulia kernel, see julia_select(); the JULIA_PERTURB
+///                    orbit is computed here, once for the frame
+/// @param w, h     -- frame size
+/// @param cw, ch   -- chunk size, chunks are numbered row by row as the module ones
+/// @param iters    -- w * h iteration counts, written by the workers
+/// @param threads  -- number of workers, 0 for the compute cpus of the
+///                    placement (see affinity_workers()) or the online cpus
+/// @param sched    -- source of the chunks (SCHED_LOCAL side), shared with the
+///                    remote module in the hybrid mode
+///
+/// @return engine handle or NULL on error
+///
+/// Every chunk is computed into a private buffer and copied into iters only if
+/// it is the first result of the chunk. If the frame is point symmetric (see
+/// julia_mirror()), the pixels mirroring an already kept chunk are copied from
+/// iters instead of computed.
+///
+/// The cost of every chunk is predicted by a coarse pre-pass (a few of its
+/// pixels, nothing for the pixels that will be mirrored) and handed to the
+/// scheduler, the expensive chunks go first. A worker without a chunk to take
+/// helps the others by the rows they have not started yet, so an expensive
+/// chunk at the end of the frame is split among all the idle workers.
+/// ----------------------------------------------------------------------------
+cpu_engine *cpu_start(const julia_params_dd *p, julia_kernel kernel, int w, int h, int cw, int ch, uint8_t *iters, int threads, scheduler *sched);
+
+/// ----------------------------------------------------------------------------
+/// @brief cpu_poll -- chunks finished since the previous call (single consumer)
+///
+/// @param cids     -- at most max chunk ids kept from the local workers, their
+///                    part of iters is final
+///
+/// @return number of chunk ids stored in cids
+/// ----------------------------------------------------------------------------
+int cpu_poll(cpu_engine *e, int *cids, int max);
+
+/// ----------------------------------------------------------------------------
+/// @brief cpu_abort -- workers do not take any further chunk
+/// ----------------------------------------------------------------------------
+void cpu_abort(cpu_engine *e);
+
+/// ----------------------------------------------------------------------------
+/// @brief cpu_running -- true until the last worker has finished its chunk
+/// ----------------------------------------------------------------------------
+bool cpu_running(cpu_engine *e);
+
+/// ----------------------------------------------------------------------------
+/// @brief cpu_mirrored -- pixels copied from their mirror so far
+/// ----------------------------------------------------------------------------
+long cpu_mirrored(cpu_engine *e);
+
+/// ----------------------------------------------------------------------------
+/// @brief cpu_busy -- workers computing a chunk right now
+/// ----------------------------------------------------------------------------
+int cpu_busy(cpu_engine *e);
+
+/// ----------------------------------------------------------------------------
+/// @brief cpu_chunk_time -- compute time of a chunk returned by cpu_poll() in s,
+/// the sum of its rows if other workers helped
+/// ----------------------------------------------------------------------------
+double cpu_chunk_time(cpu_engine *e, int cid);
+
+/// ----------------------------------------------------------------------------
+/// @brief cpu_chunk_taken -- when a worker took a chunk returned by cpu_poll(),
+/// CLOCK_MONOTONIC in s
+/// ----------------------------------------------------------------------------
+double cpu_chunk_taken(cpu_engine *e, int cid);
+
+/// ----------------------------------------------------------------------------
+/// @brief cpu_get_stats -- the pre-pass and the work of the workers so far
+/// ----------------------------------------------------------------------------
+void cpu_get_stats(cpu_engine *e, cpu_stats *st);
+
+/// ----------------------------------------------------------------------------
+/// @brief cpu_finish -- join the workers and free the engine
+/// ----------------------------------------------------------------------------
+void cpu_finish(cpu_engine *e);
+
+#endif
+
+/* end of cpu_engine.h */
@@ -0,0 +1,80 @@
+/*
+ * Filename: crc32c.c
+ * Date:     2026/10/19
+ */
+
+#include <string.h>
+
+#include <pthread.h>
+
+#include "crc32c.h"
+
+#define CRC32C_POLY 0x82f63b78 // reflected Castagnoli polynomial
+
+typedef uint32_t (*crc_fnc)(uint32_t crc, const uint8_t *p, size_t len);
+
+static uint32_t table[256];
+static crc_fnc crc_impl;
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+// - function -----------------------------------------------------------------
+static uint32_t crc_table(uint32_t crc, const uint8_t *p, size_t len)
+{
+   while (len--) {
+      crc = table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+   }
+   return crc;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// - function -----------------------------------------------------------------
+__attribute__((target("sse4.2")))
+static uint32_t crc_sse42(uint32_t crc, const uint8_t *p, size_t len)
+{
+#ifdef __x86_64__
+   uint64_t c = crc;
+   for (; len >= 8; p += 8, len -= 8) {
+      uint64_t v;
+      memcpy(&v, p, 8);
+      c = __builtin_ia32_crc32di(c, v);
+   }
+   crc = c;
+#endif
+   for (; len >= 4; p += 4, len -= 4) {
+      uint32_t v;
+      memcpy(&v, p, 4);
+      crc = __builtin_ia32_crc32si(crc, v);
+   }
+   while (len--) {
+      crc = __builtin_ia32_crc32qi(crc, *p++);
+   }
+   return crc;
+}
+#endif
+
+// - function -----------------------------------------------------------------
+static void crc_init(void)
+{
+   for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; ++k) {
+         c = c & 1 ? (c >> 1) ^ CRC32C_POLY : c >> 1;
+      }
+      table[i] = c;
+   }
+   crc_impl = crc_table;
+#if defined(__x86_64__) || defined(__i386__)
+   if (__builtin_cpu_supports("sse4.2")) {
+      crc_impl = crc_sse42;
+   }
+#endif
+}
+
+// - function -----------------------------------------------------------------
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len)
+{
+   pthread_once(&crc_once, crc_init);
+   return ~crc_impl(~crc, buf, len);
+}
+
+/* end of crc32c.c */
@@ -0,0 +1,28 @@
+/*
+ * Filename: crc32c.h
+ * Date:     2026/10/19
+ *
+ * CRC32C (Castagnoli) of the bulk message payloads, by the SSE4.2 crc32
+ * instruction where the cpu has it, table driven otherwise.
+ */
+
+#ifndef __CRC32C_H__
+#define __CRC32C_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// ----------------------------------------------------------------------------
+/// @brief crc32c
+///
+/// @param crc    -- 0 to start, or the crc of the preceding data to continue
+/// @param buf
+/// @param len
+///
+/// @return crc32c(crc32c(0, a), b) is the crc of a followed by b
+/// ----------------------------------------------------------------------------
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len);
+
+#endif
+
+/* end of crc32c.h */
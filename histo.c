@@ -0,0 +1,241 @@
+/*
+ * Filename: histo.c
+ * Date:     2026/10/19
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <pthread.h>
+
+#include "histo.h"
+
+#define HISTO_SUB (1 << HISTO_SUB_BITS)
+#define HISTO_ENTRY 7 // packed bucket: stage, bucket, count
+
+typedef struct histo_node {
+   histo h;                 // written by the owner thread only
+   bool free;               // the owner has exited, the node can be taken (atomic)
+   struct histo_node *next; // immutable once the node is in the list
+} histo_node;
+
+static histo_node *nodes;     // pushed by CAS, never removed
+static __thread histo_node *mine;
+static pthread_key_t key;     // releases the node when its thread exits
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+static const char *stage_names[STAGES] = { "compute", "encode", "write", "read", "decode", "color", "blit" };
+
+// - function -----------------------------------------------------------------
+uint64_t histo_now(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+// - function -----------------------------------------------------------------
+static void node_release(void *d)
+{
+   __atomic_store_n(&((histo_node*)d)->free, true, __ATOMIC_RELEASE);
+}
+
+// - function -----------------------------------------------------------------
+static void key_init(void)
+{
+   pthread_key_create(&key, node_release);
+}
+
+// - function -----------------------------------------------------------------
+static histo_node *node_take(void)
+{
+   pthread_once(&once, key_init);
+   histo_node *n = __atomic_load_n(&nodes, __ATOMIC_ACQUIRE);
+   for (; n; n = n->next) { // the worker threads come and go with every frame
+      bool f = true;
+      if (__atomic_compare_exchange_n(&n->free, &f, false, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+         break;
+      }
+   }
+   if (n == NULL && (n = calloc(1, sizeof(histo_node))) != NULL) {
+      n->next = __atomic_load_n(&nodes, __ATOMIC_RELAXED);
+      while (!__atomic_compare_exchange_n(&nodes, &n->next, n, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+   }
+   if (n) {
+      pthread_setspecific(key, n);
+   }
+   return n;
+}
+
+// - function -----------------------------------------------------------------
+static inline int bucket(uint64_t ns)
+{
+   if (ns >> HISTO_MAX_BITS) {
+      return HISTO_BUCKETS - 1;
+   }
+   if (ns < HISTO_SUB) {
+      return ns;
+   }
+   const int k = 63 - __builtin_clzll(ns);
+   return ((k - HISTO_SUB_BITS + 1) << HISTO_SUB_BITS) + ((ns >> (k - HISTO_SUB_BITS)) & (HISTO_SUB - 1));
+}
+
+// - function -----------------------------------------------------------------
+static uint64_t bucket_low(int i)
+{
+   if (i < HISTO_SUB) {
+      return i;
+   }
+   const int k = (i >> HISTO_SUB_BITS) + HISTO_SUB_BITS - 1;
+   return (uint64_t)(HISTO_SUB + (i & (HISTO_SUB - 1))) << (k - HISTO_SUB_BITS);
+}
+
+// - function -----------------------------------------------------------------
+static double bucket_mid(int i)
+{
+   return i + 1 < HISTO_BUCKETS ? (bucket_low(i) + bucket_low(i + 1)) / 2.0 : bucket_low(i);
+}
+
+// - function -----------------------------------------------------------------
+void histo_add(histo_stage stage, uint64_t ns)
+{
+   histo_node *n = mine;
+   if (n == NULL && (n = mine = node_take()) == NULL) {
+      return;
+   }
+   uint64_t *c = &n->h.count[stage][bucket(ns)];
+   __atomic_store_n(c, *c + 1, __ATOMIC_RELAXED); // single writer, no read-modify-write needed
+}
+
+// - function -----------------------------------------------------------------
+void histo_collect(histo *h)
+{
+   memset(h, 0, sizeof(histo));
+   for (histo_node *n = __atomic_load_n(&nodes, __ATOMIC_ACQUIRE); n; n = n->next) {
+      for (int s = 0; s < STAGES; ++s) {
+         for (int i = 0; i < HISTO_BUCKETS; ++i) {
+            h->count[s][i] += __atomic_load_n(&n->h.count[s][i], __ATOMIC_RELAXED);
+         }
+      }
+   }
+}
+
+// - function -----------------------------------------------------------------
+int histo_pack(const histo *h, uint8_t *buf, int size)
+{
+   int len = 0;
+   for (int s = 0; s < STAGES; ++s) {
+      for (int i = 0; i < HISTO_BUCKETS && len + HISTO_ENTRY <= size; ++i) {
+         const uint32_t c = h->count[s][i] > UINT32_MAX ? UINT32_MAX : h->count[s][i];
+         if (c == 0) {
+            continue;
+         }
+         uint8_t *p = buf + len;
+         p[0] = s;
+         p[1] = i & 0xff;
+         p[2] = i >> 8;
+         for (int j = 0; j < 4; ++j) {
+            p[3 + j] = c >> (8 * j);
+         }
+         len += HISTO_ENTRY;
+      }
+   }
+   return len;
+}
+
+// - function -----------------------------------------------------------------
+bool histo_unpack(const uint8_t *buf, int len, histo *h)
+{
+   memset(h, 0, sizeof(histo));
+   if (len % HISTO_ENTRY) {
+      return false;
+   }
+   for (const uint8_t *p = buf; p < buf + len; p += HISTO_ENTRY) {
+      const int i = p[1] | p[2] << 8;
+      if (p[0] >= STAGES || i >= HISTO_BUCKETS) {
+         return false;
+      }
+      h->count[p[0]][i] = p[3] | p[4] << 8 | p[5] << 16 | (uint32_t)p[6] << 24;
+   }
+   return true;
+}
+
+typedef struct {
+   uint64_t count;
+   double mean;
+   double p50;
+   double p90;
+   double p99;
+   double max;
+} stage_summary;
+
+// - function -----------------------------------------------------------------
+static stage_summary summarize(const uint64_t *c)
+{
+   // the values are the bucket midpoints, within the 6 % of the bucket width
+   stage_summary s = { 0 };
+   for (int i = 0; i < HISTO_BUCKETS; ++i) {
+      s.count += c[i];
+      s.mean += c[i] * bucket_mid(i);
+   }
+   if (s.count == 0) {
+      return s;
+   }
+   s.mean /= s.count;
+   double *p[] = { &s.p50, &s.p90, &s.p99 };
+   const double q[] = { 0.5, 0.9, 0.99 };
+   uint64_t seen = 0;
+   int k = 0;
+   for (int i = 0; i < HISTO_BUCKETS; ++i) {
+      seen += c[i];
+      while (k < 3 && seen > 0 && seen >= q[k] * s.count) {
+         *p[k++] = bucket_mid(i);
+      }
+      if (c[i]) {
+         s.max = i + 1 < HISTO_BUCKETS ? bucket_low(i + 1) : bucket_low(i);
+      }
+   }
+   return s;
+}
+
+// - function -----------------------------------------------------------------
+void histo_print(const histo *h, const char *who, FILE *f)
+{
+   fprintf(f, "%s stage latency [us]\r\n", who);
+   fprintf(f, "%-8s %10s %10s %10s %10s %10s %10s\r\n", "stage", "count", "mean", "p50", "p90", "p99", "max");
+   for (int st = 0; st < STAGES; ++st) {
+      const stage_summary s = summarize(h->count[st]);
+      if (s.count) {
+         fprintf(f, "%-8s %10lu %10.1f %10.1f %10.1f %10.1f %10.1f\r\n", stage_names[st], (unsigned long)s.count,
+               s.mean * 1e-3, s.p50 * 1e-3, s.p90 * 1e-3, s.p99 * 1e-3, s.max * 1e-3);
+      }
+   }
+}
+
+// - function -----------------------------------------------------------------
+void histo_json(const histo *h, const char *who, FILE *f)
+{
+   fprintf(f, "{\"process\": \"%s\", \"stages\": {", who);
+   const char *sep = "";
+   for (int st = 0; st < STAGES; ++st) {
+      const stage_summary s = summarize(h->count[st]);
+      if (s.count == 0) {
+         continue;
+      }
+      fprintf(f, "%s\n   \"%s\": {\"count\": %lu, \"mean_us\": %.3f, \"p50_us\": %.3f, \"p90_us\": %.3f, \"p99_us\": %.3f, \"max_us\": %.3f, \"buckets\": [",
+            sep, stage_names[st], (unsigned long)s.count, s.mean * 1e-3, s.p50 * 1e-3, s.p90 * 1e-3, s.p99 * 1e-3, s.max * 1e-3);
+      const char *bsep = "";
+      for (int i = 0; i < HISTO_BUCKETS; ++i) {
+         if (h->count[st][i]) {
+            fprintf(f, "%s[%lu, %lu]", bsep, (unsigned long)bucket_low(i), (unsigned long)h->count[st][i]);
+            bsep = ", ";
+         }
+      }
+      fprintf(f, "]}");
+      sep = ",";
+   }
+   fprintf(f, "\n}}\n");
+}
+
+/* end of histo.c */
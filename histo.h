@@ -0,0 +1,95 @@
+/*
+ * Filename: histo.h
+ * Date:     2026/10/19
+ *
+ * Per-stage latency histograms of the render pipeline. Every thread records
+ * into its own histogram without locking, a dump sums them all. Build with
+ * make NO_HISTO=1 to compile the probes out.
+ */
+
+#ifndef __HISTO_H__
+#define __HISTO_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum {
+   STAGE_COMPUTE,   // one chunk by libjulia
+   STAGE_ENCODE,    // packing and framing of a chunk
+   STAGE_WRITE,     // write into the pipe
+   STAGE_READ,      // read from the pipe
+   STAGE_DECODE,    // parse of a message, unpacking of a chunk
+   STAGE_COLOR,     // iteration counts to rgb
+   STAGE_BLIT,      // window redraw and video sink
+   STAGES
+} histo_stage;
+
+// log-linear buckets of nanoseconds: 2^HISTO_SUB_BITS buckets per power of two
+// (about 6 % wide), values from 2^HISTO_MAX_BITS ns (18 minutes) on share the last one
+#define HISTO_SUB_BITS 4
+#define HISTO_MAX_BITS 40
+#define HISTO_BUCKETS ((HISTO_MAX_BITS - HISTO_SUB_BITS + 1) << HISTO_SUB_BITS)
+
+typedef struct {
+   uint64_t count[STAGES][HISTO_BUCKETS];
+} histo;
+
+#ifndef NO_HISTO
+#define HISTO_NOW() histo_now()
+#define HISTO_ADD(stage, ns) histo_add((stage), (ns))
+#else
+#define HISTO_NOW() ((uint64_t)0)
+#define HISTO_ADD(stage, ns) ((void)(ns))
+#endif
+
+/// ----------------------------------------------------------------------------
+/// @brief histo_now -- monotonic clock in ns (vDSO, no system call)
+/// ----------------------------------------------------------------------------
+uint64_t histo_now(void);
+
+/// ----------------------------------------------------------------------------
+/// @brief histo_add -- record one sample into the histogram of the calling thread
+///
+/// The first call of a thread takes a histogram left by an exited thread or
+/// allocates a new one; the counts of exited threads are kept.
+/// ----------------------------------------------------------------------------
+void histo_add(histo_stage stage, uint64_t ns);
+
+/// ----------------------------------------------------------------------------
+/// @brief histo_collect -- sum of the histograms of all threads into h
+///
+/// Lock-free, the threads keep recording while the counts are read.
+/// ----------------------------------------------------------------------------
+void histo_collect(histo *h);
+
+/// ----------------------------------------------------------------------------
+/// @brief histo_pack -- nonzero buckets of h as [stage][bucket, 16 bit][count, 32 bit]
+///
+/// @return bytes written into buf, at most size
+/// ----------------------------------------------------------------------------
+int histo_pack(const histo *h, uint8_t *buf, int size);
+
+/// ----------------------------------------------------------------------------
+/// @brief histo_unpack -- h from the buckets written by histo_pack
+///
+/// @return false if buf is malformed
+/// ----------------------------------------------------------------------------
+bool histo_unpack(const uint8_t *buf, int len, histo *h);
+
+/// ----------------------------------------------------------------------------
+/// @brief histo_print -- table of count, mean and percentiles per stage
+///
+/// @param who    -- name of the process in the title
+/// ----------------------------------------------------------------------------
+void histo_print(const histo *h, const char *who, FILE *f);
+
+/// ----------------------------------------------------------------------------
+/// @brief histo_json -- one JSON object with the percentiles and the nonzero
+/// buckets [lower bound ns, count] of every stage that has samples
+/// ----------------------------------------------------------------------------
+void histo_json(const histo *h, const char *who, FILE *f);
+
+#endif
+
+/* end of histo.h */
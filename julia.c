@@ -0,0 +1,243 @@
+/*
+ * Filename: julia.c
+ * Date:     2026/10/19
+ */
+
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+
+#include "julia.h"
+#include "julia_dd.h"
+
+// - function -----------------------------------------------------------------
+uint8_t julia_point(double re, double im, double c_re, double c_im, int n)
+{
+   // z^2 is kept for the escape test of the next iteration
+   double zr = re, zi = im;
+   double zr2 = zr * zr, zi2 = zi * zi;
+   int k = 0;
+   while (zr2 + zi2 < 4.0 && k < n) {
+      zi = 2 * zr * zi + c_im;
+      zr = zr2 - zi2 + c_re;
+      zr2 = zr * zr;
+      zi2 = zi * zi;
+      ++k;
+   }
+   return k;
+}
+
+// - function -----------------------------------------------------------------
+void julia_compute(const julia_params *p, int x0, int y0, int w, int h, uint8_t *out, int stride)
+{
+   for (int y = 0; y < h; ++y) {
+      const double im = p->im + (y0 + y) * p->d_im;
+      uint8_t *row = out + y * stride;
+      for (int x = 0; x < w; ++x) {
+         row[x] = julia_point(p->re + (x0 + x) * p->d_re, im, p->c_re, p->c_im, p->n);
+      }
+   }
+}
+
+// - function -----------------------------------------------------------------
+uint8_t julia_point_float(float re, float im, float c_re, float c_im, int n)
+{
+   float zr = re, zi = im;
+   float zr2 = zr * zr, zi2 = zi * zi;
+   int k = 0;
+   while (zr2 + zi2 < 4.0f && k < n) {
+      zi = 2 * zr * zi + c_im;
+      zr = zr2 - zi2 + c_re;
+      zr2 = zr * zr;
+      zi2 = zi * zi;
+      ++k;
+   }
+   return k;
+}
+
+// - function -----------------------------------------------------------------
+void julia_compute_float(const julia_params *p, int x0, int y0, int w, int h, uint8_t *out, int stride)
+{
+   // the same iteration as julia_point_float() in JULIA_FLOAT_LANES lanes of
+   // one 16 byte vector register, twice the lanes of double
+   typedef float v4sf __attribute__((vector_size(16)));
+   typedef int32_t v4si __attribute__((vector_size(16)));
+   enum { L = JULIA_FLOAT_LANES };
+   const v4sf zero = { 0 };
+   const v4sf c_re = zero + (float)p->c_re;
+   const v4sf c_im = zero + (float)p->c_im;
+   const v4sf four = zero + 4.0f;
+   for (int y = 0; y < h; ++y) {
+      const float im = p->im + (y0 + y) * p->d_im;
+      for (int x = 0; x < w; x += L) {
+         v4sf zr, zi;
+         for (int l = 0; l < L; ++l) { // the lanes past the row end are computed and dropped
+            zr[l] = p->re + (x0 + x + l) * p->d_re;
+            zi[l] = im;
+         }
+         v4si cnt = { 0 };
+         v4si alive = cnt - 1;
+         v4sf zr2 = zr * zr, zi2 = zi * zi;
+         for (int k = 0; k < p->n; ++k) {
+            alive &= zr2 + zi2 < four;
+            if (!(alive[0] | alive[1] | alive[2] | alive[3])) {
+               break;
+            }
+            cnt -= alive; // true is -1
+            zi = 2 * zr * zi + c_im;
+            zr = zr2 - zi2 + c_re;
+            zr2 = zr * zr;
+            zi2 = zi * zi;
+         }
+         for (int l = 0; l < L && x + l < w; ++l) {
+            out[y * stride + x + l] = cnt[l];
+         }
+      }
+   }
+}
+
+// - function -----------------------------------------------------------------
+julia_dd julia_coord(julia_dd origin, julia_dd step, int i)
+{
+   return dd_add(origin, dd_mul_d(step, i));
+}
+
+// - function -----------------------------------------------------------------
+bool julia_mirror(const julia_params_dd *p, int *ox, int *oy)
+{
+   // re + ox * d_re = -re, the same for im
+   const double kx = -2 * (p->re.hi + p->re.lo) / (p->d_re.hi + p->d_re.lo);
+   const double ky = -2 * (p->im.hi + p->im.lo) / (p->d_im.hi + p->d_im.lo);
+   if (!(fabs(kx) < INT_MAX / 2 && fabs(ky) < INT_MAX / 2)) { // also NaN for zero spacing
+      return false;
+   }
+   *ox = lround(kx);
+   *oy = lround(ky);
+   return fabs(kx - *ox) < JULIA_MIRROR_EPS && fabs(ky - *oy) < JULIA_MIRROR_EPS;
+}
+
+// - function -----------------------------------------------------------------
+julia_params julia_params_from_dd(const julia_params_dd *p)
+{
+   return (julia_params){ p->c_re.hi, p->c_im.hi, p->re.hi, p->im.hi, p->d_re.hi, p->d_im.hi, p->n };
+}
+
+// - function -----------------------------------------------------------------
+void julia_compute_dd(const julia_params_dd *p, int x0, int y0, int w, int h, uint8_t *out, int stride)
+{
+   enum { L = JULIA_DD_LANES };
+   for (int y = 0; y < h; ++y) {
+      const julia_dd im = julia_coord(p->im, p->d_im, y0 + y);
+      for (int x = 0; x < w; x += L) {
+         julia_dd zr[L], zi[L];
+         int alive[L], cnt[L];
+         for (int l = 0; l < L; ++l) { // the lanes past the row end are computed and dropped
+            zr[l] = julia_coord(p->re, p->d_re, x0 + x + l);
+            zi[l] = im;
+            alive[l] = 1;
+            cnt[l] = 0;
+         }
+         for (int k = 0; k < p->n; ++k) {
+            int any = 0;
+            for (int l = 0; l < L; ++l) {
+               const julia_dd zr2 = dd_sqr(zr[l]);
+               const julia_dd zi2 = dd_sqr(zi[l]);
+               alive[l] &= zr2.hi + zi2.hi < 4.0;
+               cnt[l] += alive[l];
+               any |= alive[l];
+               const julia_dd t = dd_mul(zr[l], zi[l]);
+               zi[l] = dd_add((julia_dd){ 2 * t.hi, 2 * t.lo }, p->c_im);
+               zr[l] = dd_add(dd_add(zr2, (julia_dd){ -zi2.hi, -zi2.lo }), p->c_re);
+            }
+            if (!any) {
+               break;
+            }
+         }
+         for (int l = 0; l < L && x + l < w; ++l) {
+            out[y * stride + x + l] = cnt[l];
+         }
+      }
+   }
+}
+
+// - function -----------------------------------------------------------------
+void julia_compute_float128(const julia_params_dd *p, int x0, int y0, int w, int h, uint8_t *out, int stride)
+{
+#ifdef __SIZEOF_FLOAT128__
+   typedef __float128 q;
+   const q c_re = (q)p->c_re.hi + p->c_re.lo, c_im = (q)p->c_im.hi + p->c_im.lo;
+   const q d_re = (q)p->d_re.hi + p->d_re.lo, d_im = (q)p->d_im.hi + p->d_im.lo;
+   for (int y = 0; y < h; ++y) {
+      for (int x = 0; x < w; ++x) {
+         q zr = (q)p->re.hi + p->re.lo + (x0 + x) * d_re;
+         q zi = (q)p->im.hi + p->im.lo + (y0 + y) * d_im;
+         int k = 0;
+         while (zr * zr + zi * zi < 4 && k < p->n) {
+            const q t = zr * zr - zi * zi + c_re;
+            zi = 2 * zr * zi + c_im;
+            zr = t;
+            ++k;
+         }
+         out[y * stride + x] = k;
+      }
+   }
+#else
+   julia_compute_dd(p, x0, y0, w, h, out, stride);
+#endif
+}
+
+// - function -----------------------------------------------------------------
+void julia_compute_kernel(julia_kernel k, const julia_params_dd *p, const julia_orbit *o, int x0, int y0, int w, int h, uint8_t *out, int stride)
+{
+   if (k == JULIA_FLOAT || k == JULIA_DOUBLE) {
+      const julia_params d = julia_params_from_dd(p);
+      (k == JULIA_FLOAT ? julia_compute_float : julia_compute)(&d, x0, y0, w, h, out, stride);
+   } else if (k == JULIA_PERTURB && o) {
+      julia_compute_perturb(o, p, x0, y0, w, h, out, stride);
+   } else if (k == JULIA_FLOAT128) {
+      julia_compute_float128(p, x0, y0, w, h, out, stride);
+   } else {
+      julia_compute_dd(p, x0, y0, w, h, out, stride);
+   }
+}
+
+// - function -----------------------------------------------------------------
+julia_kernel julia_select(const julia_params_dd *p, int w, int h)
+{
+   double mag = 2.0; // escape radius, no pixel beyond it needs any precision
+   if (w > 0 && h > 0) { // both extremes of the box
+      const double re = fmax(fabs(p->re.hi), fabs(p->re.hi + w * p->d_re.hi));
+      const double im = fmax(fabs(p->im.hi), fabs(p->im.hi + h * p->d_im.hi));
+      mag = fmin(mag, fmax(1.0, fmax(re, im)));
+   }
+   const double d = fmin(fabs(p->d_re.hi), fabs(p->d_im.hi));
+   if (d >= ldexp(mag, JULIA_FLOAT_GUARD_BITS + ilogb(p->n > 1 ? p->n - 1 : 1) + 1 - 24)) {
+      return JULIA_FLOAT;
+   }
+   return d >= ldexp(mag, JULIA_GUARD_BITS - 53) ? JULIA_DOUBLE : JULIA_PERTURB;
+}
+
+// - function -----------------------------------------------------------------
+const char *julia_kernel_name(julia_kernel k)
+{
+   static const char *names[] = { "float", "double", "dd", "perturb", "float128" };
+   return k >= 0 && k < JULIA_KERNELS ? names[k] : "unknown";
+}
+
+// - function -----------------------------------------------------------------
+julia_kernel julia_kernel_find(const char *name)
+{
+   julia_kernel k = 0;
+   while (k < JULIA_KERNELS && strcmp(name, julia_kernel_name(k))) {
+      ++k;
+   }
+   return k;
+}
+
+// - function -----------------------------------------------------------------
+bool julia_kernel_dd(julia_kernel k)
+{
+   return k != JULIA_FLOAT && k != JULIA_DOUBLE;
+}
+
+/* end of julia.c */
@@ -0,0 +1,188 @@
+/*
+ * Filename: julia.h
+ * Date:     2026/10/19
+ *
+ * Julia set kernel (libjulia) - iteration counts of z = z^2 + c computed from
+ * the parameters alone, without any messaging or locking.
+ */
+
+#ifndef __JULIA_H__
+#define __JULIA_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define JULIA_FLOAT_LANES 4
+#define JULIA_DD_LANES 4
+#define JULIA_GUARD_BITS 12  // bits of the pixel spacing the double kernel must keep
+#define JULIA_FLOAT_GUARD_BITS 9  // the same for float, plus one bit per doubling of n
+#define JULIA_MIRROR_EPS 1e-6     // pixels, how far off the grid a mirrored point may lie
+
+typedef struct {
+   double c_re;  // re (x) part of the c constant
+   double c_im;  // im (y) part of the c constant
+   double re;    // re (x) coordinate of the pixel (0, 0)
+   double im;    // im (y) coordinate of the pixel (0, 0)
+   double d_re;  // increment in the x-coords per pixel
+   double d_im;  // increment in the y-coords per pixel
+   int n;        // number of iterations, at most 255
+} julia_params;
+
+typedef struct { // double-double, the value is hi + lo with |lo| <= ulp(hi) / 2
+   double hi;
+   double lo;
+} julia_dd;
+
+typedef struct { // the same as julia_params, for the deep zoom
+   julia_dd c_re;
+   julia_dd c_im;
+   julia_dd re;
+   julia_dd im;
+   julia_dd d_re;
+   julia_dd d_im;
+   int n;
+} julia_params_dd;
+
+typedef enum {
+   JULIA_FLOAT,     // float, vectorized, for the shallow zoom only
+   JULIA_DOUBLE,    // plain double
+   JULIA_DD,        // double-double, about 104 bits
+   JULIA_PERTURB,   // double deltas against a bignum reference orbit
+   JULIA_FLOAT128,  // __float128 reference (113 bits), slow software float
+   JULIA_KERNELS
+} julia_kernel;
+
+typedef struct julia_orbit julia_orbit;
+
+/// ----------------------------------------------------------------------------
+/// @brief julia_point -- iteration count of one point
+///
+/// @return number of iterations before |z| >= 2, n if the point never escapes
+/// ----------------------------------------------------------------------------
+uint8_t julia_point(double re, double im, double c_re, double c_im, int n);
+
+/// ----------------------------------------------------------------------------
+/// @brief julia_compute -- iteration counts of a rectangle of pixels
+///
+/// @param p      -- frame parameters, pixel (x, y) is re + x * d_re, im + y * d_im
+/// @param x0, y0 -- upper left pixel of the rectangle
+/// @param w, h   -- size of the rectangle
+/// @param out    -- caller provided buffer, pixel (x0 + x, y0 + y) is out[y * stride + x]
+/// @param stride -- row length of out
+/// ----------------------------------------------------------------------------
+void julia_compute(const julia_params *p, int x0, int y0, int w, int h, uint8_t *out, int stride);
+
+/// ----------------------------------------------------------------------------
+/// @brief julia_point_float -- julia_point in single precision
+/// ----------------------------------------------------------------------------
+uint8_t julia_point_float(float re, float im, float c_re, float c_im, int n);
+
+/// ----------------------------------------------------------------------------
+/// @brief julia_compute_float -- julia_compute in single precision
+///
+/// JULIA_FLOAT_LANES pixels are iterated in one vector, each lane gives the
+/// same count as julia_point_float() of the pixel.
+/// ----------------------------------------------------------------------------
+void julia_compute_float(const julia_params *p, int x0, int y0, int w, int h, uint8_t *out, int stride);
+
+/// ----------------------------------------------------------------------------
+/// @brief julia_compute_dd -- julia_compute in double-double arithmetic
+///
+/// Pixels are computed in groups of JULIA_DD_LANES in lockstep without
+/// branches in the lane loop, so the compiler can keep the lanes in vector
+/// registers.
+/// ----------------------------------------------------------------------------
+void julia_compute_dd(const julia_params_dd *p, int x0, int y0, int w, int h, uint8_t *out, int stride);
+
+/// ----------------------------------------------------------------------------
+/// @brief julia_compute_float128 -- reference kernel, JULIA_DD if the compiler
+///        has no __float128
+/// ----------------------------------------------------------------------------
+void julia_compute_float128(const julia_params_dd *p, int x0, int y0, int w, int h, uint8_t *out, int stride);
+
+/// ----------------------------------------------------------------------------
+/// @brief julia_orbit_create -- high precision reference orbit for JULIA_PERTURB
+///
+/// @param p      -- frame parameters, the precision follows the pixel spacing
+/// @param re, im -- reference point, preferably near the centre of the frame
+///
+/// @return orbit or NULL if out of memory
+///
+/// Two orbits are iterated in bignum arithmetic and kept rounded to double:
+/// the one of the reference point and the critical one from 0, which the
+/// pixels are rebased to when their delta outgrows the orbit (glitch) or
+/// the reference escapes. The orbit is read only, one can be shared by any
+/// number of threads computing the same frame.
+/// ----------------------------------------------------------------------------
+julia_orbit *julia_orbit_create(const julia_params_dd *p, julia_dd re, julia_dd im);
+
+void julia_orbit_free(julia_orbit *o);
+
+/// ----------------------------------------------------------------------------
+/// @brief julia_compute_perturb -- julia_compute by the perturbation theory
+///
+/// Each pixel iterates only its double precision delta from the orbit,
+/// d' = 2 Z d + d^2, so the cost is that of the double kernel at any depth
+/// the double-double frame coordinates can express.
+/// ----------------------------------------------------------------------------
+void julia_compute_perturb(const julia_orbit *o, const julia_params_dd *p, int x0, int y0, int w, int h, uint8_t *out, int stride);
+
+/// ----------------------------------------------------------------------------
+/// @brief julia_compute_kernel -- julia_compute by the given kernel
+///
+/// @param o      -- orbit of the frame for JULIA_PERTURB, JULIA_DD is used
+///                  without it; ignored by the other kernels
+/// ----------------------------------------------------------------------------
+void julia_compute_kernel(julia_kernel k, const julia_params_dd *p, const julia_orbit *o, int x0, int y0, int w, int h, uint8_t *out, int stride);
+
+/// ----------------------------------------------------------------------------
+/// @brief julia_select -- the fastest kernel precise enough for the zoom depth
+///
+/// JULIA_FLOAT while the pixel spacing keeps JULIA_FLOAT_GUARD_BITS + log2(n)
+/// of the 24 bit float mantissa below the magnitude of the coordinates, as
+/// the rounding error grows with the iterations. JULIA_DOUBLE while it keeps
+/// at least JULIA_GUARD_BITS of the 53 bit double mantissa, otherwise
+/// JULIA_PERTURB. The magnitude is the largest one in the w x h pixel box from
+/// the origin p->re, p->im, at most the escape radius 2; w or h <= 0 if the
+/// box is not known, the escape radius then.
+/// ----------------------------------------------------------------------------
+julia_kernel julia_select(const julia_params_dd *p, int w, int h);
+
+const char *julia_kernel_name(julia_kernel k);
+
+/// ----------------------------------------------------------------------------
+/// @brief julia_kernel_find -- kernel by its julia_kernel_name()
+///
+/// @return JULIA_KERNELS if the name is unknown
+/// ----------------------------------------------------------------------------
+julia_kernel julia_kernel_find(const char *name);
+
+/// ----------------------------------------------------------------------------
+/// @brief julia_kernel_dd -- true if the kernel uses the low parts of the
+///        double-double parameters, false for JULIA_FLOAT and JULIA_DOUBLE
+/// ----------------------------------------------------------------------------
+bool julia_kernel_dd(julia_kernel k);
+
+/// ----------------------------------------------------------------------------
+/// @brief julia_coord -- origin + i * step in double-double
+/// ----------------------------------------------------------------------------
+julia_dd julia_coord(julia_dd origin, julia_dd step, int i);
+
+/// ----------------------------------------------------------------------------
+/// @brief julia_mirror -- point reflection of the pixel grid
+///
+/// @param ox, oy -- set if the grid is symmetric: pixel (x, y) has the same
+///                  iteration count as pixel (ox - x, oy - y), as J(-z) = J(z)
+///
+/// @return true if -(re, im) lies on the pixel grid (within JULIA_MIRROR_EPS)
+/// ----------------------------------------------------------------------------
+bool julia_mirror(const julia_params_dd *p, int *ox, int *oy);
+
+/// ----------------------------------------------------------------------------
+/// @brief julia_params_from_dd -- the double parameters (the hi parts)
+/// ----------------------------------------------------------------------------
+julia_params julia_params_from_dd(const julia_params_dd *p);
+
+#endif
+
+/* end of julia.h */
@@ -0,0 +1,84 @@
+/*
+ * Filename: julia_dd.h
+ * Date:     2026/10/19
+ *
+ * Double-double arithmetic shared by the libjulia kernels (internal header).
+ */
+
+#ifndef __JULIA_DD_H__
+#define __JULIA_DD_H__
+
+#include "julia.h"
+
+// error free transformations (Knuth two-sum, Dekker two-product); fma is used
+// only where it is a single instruction, the software fma would be slower
+
+// - function -----------------------------------------------------------------
+static inline julia_dd dd_quick_two_sum(double a, double b)
+{
+   const double s = a + b;
+   return (julia_dd){ s, b - (s - a) };
+}
+
+// - function -----------------------------------------------------------------
+static inline julia_dd dd_two_sum(double a, double b)
+{
+   const double s = a + b;
+   const double bb = s - a;
+   return (julia_dd){ s, (a - (s - bb)) + (b - bb) };
+}
+
+// - function -----------------------------------------------------------------
+static inline julia_dd dd_two_prod(double a, double b)
+{
+   const double p = a * b;
+#ifdef __FMA__
+   return (julia_dd){ p, __builtin_fma(a, b, -p) };
+#else
+   const double split = 134217729.0; // 2^27 + 1
+   const double ta = split * a, tb = split * b;
+   const double ah = ta - (ta - a), al = a - ah;
+   const double bh = tb - (tb - b), bl = b - bh;
+   return (julia_dd){ p, ((ah * bh - p) + ah * bl + al * bh) + al * bl };
+#endif
+}
+
+// - function -----------------------------------------------------------------
+static inline julia_dd dd_add(julia_dd a, julia_dd b)
+{
+   julia_dd s = dd_two_sum(a.hi, b.hi);
+   const julia_dd t = dd_two_sum(a.lo, b.lo);
+   s = dd_quick_two_sum(s.hi, s.lo + t.hi);
+   return dd_quick_two_sum(s.hi, s.lo + t.lo);
+}
+
+// - function -----------------------------------------------------------------
+static inline julia_dd dd_mul(julia_dd a, julia_dd b)
+{
+   const julia_dd p = dd_two_prod(a.hi, b.hi);
+   return dd_quick_two_sum(p.hi, p.lo + (a.hi * b.lo + a.lo * b.hi));
+}
+
+// - function -----------------------------------------------------------------
+static inline julia_dd dd_mul_d(julia_dd a, double b)
+{
+   const julia_dd p = dd_two_prod(a.hi, b);
+   return dd_quick_two_sum(p.hi, p.lo + a.lo * b);
+}
+
+// - function -----------------------------------------------------------------
+static inline julia_dd dd_sqr(julia_dd a)
+{
+   const julia_dd p = dd_two_prod(a.hi, a.hi);
+   return dd_quick_two_sum(p.hi, p.lo + 2 * a.hi * a.lo);
+}
+
+// - function -----------------------------------------------------------------
+static inline julia_dd dd_neg(julia_dd a)
+{
+   return (julia_dd){ -a.hi, -a.lo };
+}
+
+#endif
+
+/* end of julia_dd.h */
@@ -6,6 +6,7 @@
 
 #include <string.h>
 
+#include "crc32c.h"
 #include "messages.h"
 
 // - function  ----------------------------------------------------------------
@@ -18,6 +19,7 @@ bool get_message_size(uint8_t msg_type, int *len)
       case MSG_ABORT:
       case MSG_DONE:
       case MSG_GET_VERSION:
+      case MSG_GET_STATS:
          *len = 2; // 2 bytes message - id + cksum
          break;
       case MSG_STARTUP:
@@ -35,6 +37,18 @@ bool get_message_size(uint8_t msg_type, int *len)
       case MSG_COMPUTE_DATA:
          *len = 2 + 4; // cid, dx, dy, iter
          break;
+      case MSG_SET_COMPUTE_HP:
+         *len = 2 + 8 * sizeof(double) + 2; // 2 + 4 * (hi, lo) params + n + kernel
+         break;
+      case MSG_COMPUTE_HP:
+         *len = 2 + 1 + 4 * sizeof(double) + 2; // 2 + cid + 2x(hi, lo - re, im) + n_re, n_im
+         break;
+      case MSG_COMPUTE_DATA_PACKED:
+         *len = 2 + 3 + 2; // 2 + cid, n_re, n_im + payload length (16 bit)
+         break;
+      case MSG_STATS:
+         *len = 2 + 2 + 1; // 2 + payload length (16 bit) + kernel
+         break;
       default:
          ret = false;
          break;
@@ -57,6 +71,7 @@ bool fill_message_buf(const message *msg, uint8_t *buf, int size, int *len)
       case MSG_ABORT:
       case MSG_DONE:
       case MSG_GET_VERSION:
+      case MSG_GET_STATS:
          *len = 1;
          break;
       case MSG_STARTUP:
@@ -94,6 +109,37 @@ bool fill_message_buf(const message *msg, uint8_t *buf, int size, int *len)
          buf[4] = msg->data.compute_data.iter;
          *len = 5;
          break;
+      case MSG_SET_COMPUTE_HP:
+         memcpy(&(buf[1 + 0 * sizeof(double)]), msg->data.set_compute_hp.c_re, 2 * sizeof(double));
+         memcpy(&(buf[1 + 2 * sizeof(double)]), msg->data.set_compute_hp.c_im, 2 * sizeof(double));
+         memcpy(&(buf[1 + 4 * sizeof(double)]), msg->data.set_compute_hp.d_re, 2 * sizeof(double));
+         memcpy(&(buf[1 + 6 * sizeof(double)]), msg->data.set_compute_hp.d_im, 2 * sizeof(double));
+         buf[1 + 8 * sizeof(double)] = msg->data.set_compute_hp.n;
+         buf[2 + 8 * sizeof(double)] = msg->data.set_compute_hp.kernel;
+         *len = 1 + 8 * sizeof(double) + 2;
+         break;
+      case MSG_COMPUTE_HP:
+         buf[1] = msg->data.compute_hp.cid;
+         memcpy(&(buf[2 + 0 * sizeof(double)]), msg->data.compute_hp.re, 2 * sizeof(double));
+         memcpy(&(buf[2 + 2 * sizeof(double)]), msg->data.compute_hp.im, 2 * sizeof(double));
+         buf[2 + 4 * sizeof(double) + 0] = msg->data.compute_hp.n_re;
+         buf[2 + 4 * sizeof(double) + 1] = msg->data.compute_hp.n_im;
+         *len = 1 + 1 + 4 * sizeof(double) + 2;
+         break;
+      case MSG_COMPUTE_DATA_PACKED:
+         buf[1] = msg->data.compute_data_packed.cid;
+         buf[2] = msg->data.compute_data_packed.n_re;
+         buf[3] = msg->data.compute_data_packed.n_im;
+         buf[4] = msg->data.compute_data_packed.len & 0xff;
+         buf[5] = msg->data.compute_data_packed.len >> 8;
+         *len = 6;
+         break;
+      case MSG_STATS:
+         buf[1] = msg->data.stats.len & 0xff;
+         buf[2] = msg->data.stats.len >> 8;
+         buf[3] = msg->data.stats.kernel;
+         *len = 4;
+         break;
       default: // unknown message type
          ret = false;
          break;
@@ -131,6 +177,7 @@ bool parse_message_buf(const uint8_t *buf, int size, message *msg)
          case MSG_ABORT:
          case MSG_DONE:
          case MSG_GET_VERSION:
+         case MSG_GET_STATS:
             break;
          case MSG_STARTUP:
             for (int i = 0; i < STARTUP_MSG_LEN; ++i) {
@@ -162,6 +209,31 @@ bool parse_message_buf(const uint8_t *buf, int size, message *msg)
             msg->data.compute_data.i_im = buf[3];
             msg->data.compute_data.iter = buf[4];
             break;
+         case MSG_SET_COMPUTE_HP:
+            memcpy(msg->data.set_compute_hp.c_re, &(buf[1 + 0 * sizeof(double)]), 2 * sizeof(double));
+            memcpy(msg->data.set_compute_hp.c_im, &(buf[1 + 2 * sizeof(double)]), 2 * sizeof(double));
+            memcpy(msg->data.set_compute_hp.d_re, &(buf[1 + 4 * sizeof(double)]), 2 * sizeof(double));
+            memcpy(msg->data.set_compute_hp.d_im, &(buf[1 + 6 * sizeof(double)]), 2 * sizeof(double));
+            msg->data.set_compute_hp.n = buf[1 + 8 * sizeof(double)];
+            msg->data.set_compute_hp.kernel = buf[2 + 8 * sizeof(double)];
+            break;
+         case MSG_COMPUTE_HP:
+            msg->data.compute_hp.cid = buf[1];
+            memcpy(msg->data.compute_hp.re, &(buf[2 + 0 * sizeof(double)]), 2 * sizeof(double));
+            memcpy(msg->data.compute_hp.im, &(buf[2 + 2 * sizeof(double)]), 2 * sizeof(double));
+            msg->data.compute_hp.n_re = buf[2 + 4 * sizeof(double) + 0];
+            msg->data.compute_hp.n_im = buf[2 + 4 * sizeof(double) + 1];
+            break;
+         case MSG_COMPUTE_DATA_PACKED:
+            msg->data.compute_data_packed.cid = buf[1];
+            msg->data.compute_data_packed.n_re = buf[2];
+            msg->data.compute_data_packed.n_im = buf[3];
+            msg->data.compute_data_packed.len = buf[4] | buf[5] << 8;
+            break;
+         case MSG_STATS:
+            msg->data.stats.len = buf[1] | buf[2] << 8;
+            msg->data.stats.kernel = buf[3];
+            break;
          default: // unknown message type
             ret = false;
             break;
@@ -170,4 +242,334 @@ bool parse_message_buf(const uint8_t *buf, int size, message *msg)
    return ret;
 }
 
+// - function  ----------------------------------------------------------------
+int get_payload_size(const uint8_t *buf)
+{
+   switch (buf[0]) {
+      case MSG_COMPUTE_DATA_PACKED:
+         return buf[4] | buf[5] << 8;
+      case MSG_STATS:
+         return buf[1] | buf[2] << 8;
+      default:
+         return 0;
+   }
+}
+
+// Packed chunk payload: [mode][bits][bit stream][crc32c]. The values are
+// written LSB first in the minimal width (bits) of the chunk maximum; the
+// PACK_DELTA mode replaces every value below the first row by its difference
+// from the value above (mod 2^bits), PACK_RLE writes (value, run) pairs with
+// the run length in the Elias gamma code. The encoder picks the smallest.
+// The crc (little endian) covers everything before it; the decoder updates
+// it by blocks of PACK_CRC_BLOCK bytes as they are consumed, so the payload
+// is read only once.
+
+#define PACK_CRC_BLOCK 64
+
+enum { PACK_DELTA = 1, PACK_RLE = 2, PACK_MODES = 4 };
+
+typedef struct {
+   uint8_t *buf;
+   int size;
+   int pos;
+   uint64_t acc;
+   int bits;
+} bit_writer;
+
+typedef struct {
+   const uint8_t *buf;
+   int len;
+   int pos;
+   uint64_t acc;
+   int bits;
+   uint32_t crc;   // of buf[0 .. crc_pos)
+   int crc_pos;
+} bit_reader;
+
+// - function  ----------------------------------------------------------------
+static inline void put_bits(bit_writer *w, uint32_t v, int n)
+{
+   w->acc |= (uint64_t)v << w->bits;
+   w->bits += n;
+   while (w->bits >= 8) {
+      if (w->pos < w->size) {
+         w->buf[w->pos] = w->acc;
+      }
+      w->pos += 1; // counted beyond the size, so the overflow is detected
+      w->acc >>= 8;
+      w->bits -= 8;
+   }
+}
+
+// - function  ----------------------------------------------------------------
+static inline bool get_bits(bit_reader *r, int n, uint32_t *v)
+{
+   while (r->bits < n) {
+      if (r->pos >= r->len) {
+         return false;
+      }
+      r->acc |= (uint64_t)r->buf[r->pos++] << r->bits;
+      r->bits += 8;
+      if (r->pos - r->crc_pos == PACK_CRC_BLOCK) { // the block is still in L1
+         r->crc = crc32c(r->crc, r->buf + r->crc_pos, PACK_CRC_BLOCK);
+         r->crc_pos = r->pos;
+      }
+   }
+   *v = r->acc & ((1u << n) - 1);
+   r->acc >>= n;
+   r->bits -= n;
+   return true;
+}
+
+// - function  ----------------------------------------------------------------
+static inline int floor_log2(uint32_t v)
+{
+   return 31 - __builtin_clz(v);
+}
+
+// - function  ----------------------------------------------------------------
+static inline void put_gamma(bit_writer *w, uint32_t v) // v >= 1
+{
+   const int k = floor_log2(v);
+   put_bits(w, 0, k);
+   put_bits(w, 1, 1);
+   put_bits(w, v & ((1u << k) - 1), k);
+}
+
+// - function  ----------------------------------------------------------------
+static inline bool get_gamma(bit_reader *r, uint32_t *v)
+{
+   int k = 0;
+   uint32_t b = 0;
+   while (get_bits(r, 1, &b) && !b) {
+      if (++k > 16) {
+         return false;
+      }
+   }
+   if (!b || !get_bits(r, k, v)) {
+      return false;
+   }
+   *v |= 1u << k;
+   return true;
+}
+
+// - function  ----------------------------------------------------------------
+static inline uint8_t pack_value(const uint8_t *iters, int x, int y, int stride, int mode, int mask)
+{
+   const uint8_t v = iters[y * stride + x];
+   return (mode & PACK_DELTA) && y > 0 ? (v - iters[(y - 1) * stride + x]) & mask : v;
+}
+
+// - function  ----------------------------------------------------------------
+static void pack_stream(const uint8_t *iters, int w, int h, int stride, int mode, int bits, bit_writer *bw)
+{
+   const int mask = (1 << bits) - 1;
+   int run = 0;
+   uint8_t prev = 0;
+   for (int y = 0; y < h; ++y) {
+      for (int x = 0; x < w; ++x) {
+         const uint8_t v = pack_value(iters, x, y, stride, mode, mask);
+         if (!(mode & PACK_RLE)) {
+            put_bits(bw, v, bits);
+         } else if (run > 0 && v == prev) {
+            run += 1;
+         } else {
+            if (run > 0) {
+               put_bits(bw, prev, bits);
+               put_gamma(bw, run);
+            }
+            prev = v;
+            run = 1;
+         }
+      }
+   }
+   if (run > 0) {
+      put_bits(bw, prev, bits);
+      put_gamma(bw, run);
+   }
+   put_bits(bw, 0, 7); // flush the last byte
+}
+
+// - function  ----------------------------------------------------------------
+int pack_chunk(const uint8_t *iters, int w, int h, int stride, uint8_t *buf, int size)
+{
+   uint8_t max = 0;
+   for (int y = 0; y < h; ++y) {
+      for (int x = 0; x < w; ++x) {
+         max |= iters[y * stride + x];
+      }
+   }
+   const int bits = max ? floor_log2(max) + 1 : 0;
+   // the sizes of the variants are counted without writing (size 0)
+   int best = 0;
+   int best_len = -1;
+   for (int mode = 0; mode < PACK_MODES; ++mode) {
+      if (mode == PACK_DELTA) {
+         continue; // without the runs the delta has the same width
+      }
+      bit_writer bw = { .buf = NULL, .size = 0 };
+      pack_stream(iters, w, h, stride, mode, bits, &bw);
+      if (best_len < 0 || bw.pos < best_len) {
+         best = mode;
+         best_len = bw.pos;
+      }
+   }
+   if (size < 6 + best_len) {
+      return 0;
+   }
+   bit_writer bw = { .buf = buf + 2, .size = size - 6 };
+   pack_stream(iters, w, h, stride, best, bits, &bw);
+   buf[0] = best;
+   buf[1] = bits;
+   const int len = 2 + bw.pos;
+   const uint32_t crc = crc32c(0, buf, len);
+   for (int i = 0; i < 4; ++i) {
+      buf[len + i] = crc >> (8 * i);
+   }
+   return len + 4;
+}
+
+// - function  ----------------------------------------------------------------
+bool unpack_chunk(const uint8_t *buf, int len, int w, int h, uint8_t *out, int stride)
+{
+   if (len < 6 || buf[0] >= PACK_MODES || buf[1] > 8) {
+      return false;
+   }
+   const int mode = buf[0];
+   const int bits = buf[1];
+   const int mask = (1 << bits) - 1;
+   bit_reader br = { .buf = buf + 2, .len = len - 6, .crc = crc32c(0, buf, 2) };
+   uint32_t v = 0;
+   uint32_t run = 0;
+   for (int y = 0; y < h; ++y) {
+      uint8_t *row = out + y * stride;
+      for (int x = 0; x < w; ++x) {
+         if (!(mode & PACK_RLE)) {
+            if (!get_bits(&br, bits, &v)) {
+               return false;
+            }
+         } else if (run == 0) {
+            if (!get_bits(&br, bits, &v) || !get_gamma(&br, &run)) {
+               return false;
+            }
+         }
+         run -= run > 0;
+         row[x] = (mode & PACK_DELTA) && y > 0 ? (v + row[x - stride]) & mask : v;
+      }
+   }
+   const uint32_t crc = crc32c(br.crc, br.buf + br.crc_pos, br.len - br.crc_pos);
+   const uint8_t *p = buf + len - 4;
+   return run == 0 && crc == (p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24);
+}
+
+// - function  ----------------------------------------------------------------
+// bytes of the frame of body len covered by its crc, the packed payload is not
+static int frame_checked(const uint8_t *f, int len)
+{
+   int size;
+   if (f[FRAME_HEADER] == MSG_COMPUTE_DATA_PACKED && get_message_size(f[FRAME_HEADER], &size) && size <= len) {
+      return FRAME_HEADER + size;
+   }
+   return FRAME_HEADER + len;
+}
+
+// - function  ----------------------------------------------------------------
+int frame_seal(uint8_t *buf, int len)
+{
+   buf[0] = FRAME_SYNC;
+   buf[1] = len & 0xff;
+   buf[2] = len >> 8;
+   const uint32_t crc = crc32c(0, buf, frame_checked(buf, len));
+   for (int i = 0; i < FRAME_TRAILER; ++i) {
+      buf[FRAME_HEADER + len + i] = crc >> (8 * i);
+   }
+   return FRAME_HEADER + len + FRAME_TRAILER;
+}
+
+// - function  ----------------------------------------------------------------
+static int frame_size(const uint8_t *f, int avail)
+{
+   // the body length must match its message, so a corrupted length is
+   // rejected at once instead of waiting for bytes that never come;
+   // return the frame size, 0 if more bytes are needed, -1 if invalid
+   int size;
+   if (avail < FRAME_HEADER + 1) {
+      return 0;
+   }
+   const uint8_t *body = f + FRAME_HEADER;
+   if (!get_message_size(body[0], &size)) {
+      return -1;
+   }
+   if (avail < FRAME_HEADER + size) {
+      return 0;
+   }
+   size += get_payload_size(body);
+   if ((f[1] | f[2] << 8) != size) {
+      return -1;
+   }
+   size += FRAME_HEADER + FRAME_TRAILER;
+   return avail < size ? 0 : size;
+}
+
+// - function  ----------------------------------------------------------------
+static void frame_lost(frame_reader *r)
+{
+   if (!r->lost) {
+      r->resyncs += 1;
+      r->lost = true;
+   }
+}
+
+// - function  ----------------------------------------------------------------
+const uint8_t *frame_next(frame_reader *r, int *len)
+{
+   r->pos += r->taken;
+   r->taken = 0;
+   while (r->pos < r->len) {
+      const uint8_t *f = r->buf + r->pos;
+      const uint8_t *sync = memchr(f, FRAME_SYNC, r->len - r->pos);
+      if (sync != f) { // garbage up to the next sync byte
+         frame_lost(r);
+         r->pos = sync ? sync - r->buf : r->len;
+         continue;
+      }
+      const int size = frame_size(f, r->len - r->pos);
+      if (size == 0) { // incomplete, moved to the start of buf if its rest may not fit
+         if (sizeof(r->buf) - r->pos < FRAME_HEADER + FRAME_MAX_BODY + FRAME_TRAILER) {
+            memmove(r->buf, f, r->len - r->pos);
+            r->len -= r->pos;
+            r->pos = 0;
+         }
+         return NULL;
+      }
+      if (size > 0) {
+         const uint8_t *p = f + size - FRAME_TRAILER;
+         if (crc32c(0, f, frame_checked(f, size - FRAME_HEADER - FRAME_TRAILER)) == (p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24)) {
+            r->taken = size;
+            r->lost = false;
+            *len = size - FRAME_HEADER - FRAME_TRAILER;
+            return f + FRAME_HEADER;
+         }
+      }
+      // a sync byte inside garbage is not counted as a corrupted frame
+      r->corrupt += size > 0 || !r->lost;
+      frame_lost(r);
+      r->pos += 1;
+   }
+   r->len = r->pos = 0;
+   return NULL;
+}
+
+// - function  ----------------------------------------------------------------
+void frame_drop(frame_reader *r)
+{
+   r->pos += r->taken;
+   r->taken = 0;
+   if (r->pos < r->len) {
+      r->corrupt += !r->lost;
+      frame_lost(r);
+      r->pos += 1;
+   }
+}
+
 /* end of messages.c */
\ No newline at end of file
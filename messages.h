@@ -22,6 +22,11 @@ typedef enum {
    MSG_SET_COMPUTE,      // set computation parameters
    MSG_COMPUTE,          // request computation of a batch of tasks (chunk_id, nbr_tasks)
    MSG_COMPUTE_DATA,     // computed result (chunk_id, result)
+   MSG_SET_COMPUTE_HP,   // set computation parameters, double-double (deep zoom)
+   MSG_COMPUTE_HP,       // request computation of a chunk with double-double origin
+   MSG_COMPUTE_DATA_PACKED, // computed chunk at once, followed by the packed payload
+   MSG_GET_STATS,        // request the stage latency histograms of the module
+   MSG_STATS,            // stage latency histograms, followed by the payload of histo_pack()
    MSG_NBR
 } message_type;
 
@@ -53,6 +58,23 @@ typedef struct {
    uint8_t n_im; // number of cells in y-coords
 } msg_compute;
 
+typedef struct { // every value is hi + lo (double-double), [0] = hi, [1] = lo
+   double c_re[2];  // re (x) part of the c constant in recursive equation
+   double c_im[2];  // im (y) part of the c constant in recursive equation
+   double d_re[2];  // increment in the x-coords
+   double d_im[2];  // increment in the y-coords
+   uint8_t n;       // number of iterations per each pixel
+   uint8_t kernel;  // julia_kernel of the whole frame, JULIA_KERNELS to leave it to the module
+} msg_set_compute_hp;
+
+typedef struct {
+   uint8_t cid;     // chunk id
+   double re[2];    // start of the x-coords (real), hi and lo
+   double im[2];    // start of the y-coords (imaginary), hi and lo
+   uint8_t n_re;    // number of cells in x-coords
+   uint8_t n_im;    // number of cells in y-coords
+} msg_compute_hp;
+
 typedef struct {
    uint8_t cid;  // chunk id
    uint8_t i_re; // x-coords 
@@ -60,6 +82,18 @@ typedef struct {
    uint8_t iter; // number of iterations
 } msg_compute_data;
 
+typedef struct {
+   uint8_t cid;  // chunk id
+   uint8_t n_re; // number of cells in x-coords
+   uint8_t n_im; // number of cells in y-coords
+   uint16_t len; // bytes of the payload that follows the message, see pack_chunk()
+} msg_compute_data_packed;
+
+typedef struct {
+   uint16_t len;   // bytes of the payload that follows the message
+   uint8_t kernel; // julia_kernel of the last chunk computed, JULIA_KERNELS or above if none
+} msg_stats;
+
 typedef struct {
    uint8_t type;   // message type
    union {
@@ -68,6 +102,10 @@ typedef struct {
       msg_set_compute set_compute;
       msg_compute compute;
       msg_compute_data compute_data;
+      msg_set_compute_hp set_compute_hp;
+      msg_compute_hp compute_hp;
+      msg_compute_data_packed compute_data_packed;
+      msg_stats stats;
    } data;
    uint8_t cksum; // message command
 } message;
@@ -81,6 +119,57 @@ bool fill_message_buf(const message *msg, uint8_t *buf, int size, int *len);
 // parse the message from buf to msg (unmarshaling)
 bool parse_message_buf(const uint8_t *buf, int size, message *msg);
 
+// length of the payload that follows the whole message in buf, 0 if the type has none
+int get_payload_size(const uint8_t *buf);
+
+// packed chunk payload: mode, bit width, bit stream, crc32c
+#define PACKED_MAX_SIZE(w, h) (6 + (w) * (h))
+
+// pack w x h iteration counts (row stride) into buf of at least PACKED_MAX_SIZE
+// bytes, the smallest of the bit-packed, run-length and row-delta variants;
+// return the payload length, 0 if buf is too small
+int pack_chunk(const uint8_t *iters, int w, int h, int stride, uint8_t *buf, int size);
+
+// unpack the payload straight into out (row stride) and verify its crc in the
+// same pass; false if it is corrupted, out may have been written anyway
+bool unpack_chunk(const uint8_t *buf, int len, int w, int h, uint8_t *out, int stride);
+
+// frame of one message and its payload (the body): sync byte, body length
+// (16 bit), body, crc32c of the header and the body (little endian), the
+// payload of a packed chunk left out (see frame_seal())
+#define FRAME_SYNC 0xa5  // not a message type, a frame is told from a plain message by its first byte
+#define FRAME_HEADER 3
+#define FRAME_TRAILER 4
+#define FRAME_MAX_BODY UINT16_MAX
+#define FRAME_READER_SIZE (4 * (FRAME_HEADER + FRAME_MAX_BODY + FRAME_TRAILER)) // several frames per read()
+
+typedef struct { // receiver of a framed stream
+   // page aligned, the pipe pages are copied into it whole; an incomplete
+   // frame is moved back to the start only when the rest may not fit behind it
+   uint8_t buf[FRAME_READER_SIZE] __attribute__((aligned(4096)));
+   int len;       // bytes in buf, the next ones are read to buf + len
+   int pos;       // start of the first frame not returned yet
+   int taken;     // size of the frame returned last
+   bool lost;     // looking for the next sync byte
+   long corrupt;  // frames dropped for a bad crc or length
+   long resyncs;  // times the receiver had to look for the next sync byte
+} frame_reader;
+
+// frame the body of len bytes placed at buf + FRAME_HEADER, buf must have
+// FRAME_TRAILER more bytes after the body; return the frame size. The crc
+// leaves out the payload of MSG_COMPUTE_DATA_PACKED, it has a crc of its own
+// checked by unpack_chunk() in the same pass as it is unpacked
+int frame_seal(uint8_t *buf, int len);
+
+// the body of the next valid frame in r->buf (valid until the next call),
+// NULL if more bytes are needed; garbage and corrupted frames are skipped up
+// to the next sync byte, so the stream resynchronises by itself
+const uint8_t *frame_next(frame_reader *r, int *len);
+
+// give up the incomplete frame waiting in r->buf when its rest does not come
+// (a truncated write), the stream is resynchronised from its next byte on
+void frame_drop(frame_reader *r);
+
 #endif
 
 /* end of messages.h */
@@ -1,4 +1,10 @@
+#define _GNU_SOURCE // vmsplice(), F_SETPIPE_SZ
+
+#include <errno.h>
 #include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <math.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -8,11 +14,19 @@
 #include <termios.h>
 #include <threads.h>
 #include <unistd.h> // for STDIN_FILENO
-#include <complex.h> // for julia set complex numbers
+
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
 
 #include <pthread.h>
+#include "affinity.h" // --affinity
+#include "histo.h" // stage latencies
+#include "julia.h" // libjulia compute kernel
+#include "trace.h" // --trace
 #include "messages.h"
 #include "prg_io_nonblock.h" // send and recieves bites through pipe
+#include "ring.h" // lock-free queues of the output thread
 #define MY_DEVICE_OUT "/tmp/pipe.out"
 #define MY_DEVICE_IN "/tmp/pipe.in"
 
@@ -22,6 +36,58 @@ void call_termios(int reset);
 #define SIZE_C_W 64
 #define SIZE_C_H 48
 #define NUM_CHUNKS 100
+#define REQUEST_TIMEOUT_MS 100 // the rest of a started request, it is corrupted if it does not come
+#define BATCH_SIZE (FRAME_HEADER + FRAME_MAX_BODY + FRAME_TRAILER) // a ring slot holds any frame
+#define SPLICE_MIN_BYTES 16384 // smaller batches are copied by write(), a spliced page takes a whole pipe buffer
+#define PIPE_BYTES (1 << 20)   // capacity of the pipe to prgsem-main for the spliced batches in flight
+#define RECYCLE_MS 1           // the output thread checks the pipe so often while spliced batches are in flight
+
+#define OUT_BATCHES (2 * RING_SLOTS) // the slots of both rings
+
+typedef struct { // a batch lent to the pipe by vmsplice(), its slot is kept until prgsem-main reads it
+    int ring;
+    uint64_t end;  // bytes put into the pipe up to the end of the batch
+}   in_flight_t;
+
+typedef struct { // the batches of the output thread on their way into the pipe
+    ring_t *rings[2];                 // replies, results
+    struct iovec iov[OUT_BATCHES];    // taken, to be written together
+    int from[OUT_BATCHES];            // their rings
+    int n;
+    in_flight_t flight[OUT_BATCHES];  // in the order of the pipe
+    int lent[2];                      // batches of each ring in flight
+    int first;
+    int n_flight;
+    uint64_t piped;                   // bytes put into the pipe
+    bool ok;                          // the pipe accepts the writes
+    bool enlarged;                    // the pipe has room for the lent pages, set by the first splice
+}   output_t;
+
+typedef struct { // computed chunk, the source of the mirrored pixels
+    bool valid;
+    int x; // upper left pixel, counted from the origin of the frame
+    int y;
+    int w;
+    int h;
+    uint8_t *iters;
+}   chunk_cache_t;
+
+typedef struct { // one MSG_COMPUTE with the parameters of the last MSG_SET_COMPUTE, immutable once published
+    julia_params_dd p; // the origin of the chunk in p.re, p.im
+    uint32_t frame;    // generation of the parameters, one per MSG_SET_COMPUTE
+    uint32_t gen;      // generation of the request, one per MSG_COMPUTE
+    uint8_t cid;
+    uint8_t n_re;
+    uint8_t n_im;
+    uint8_t kernel;    // julia_kernel of the whole frame, chosen once per MSG_SET_COMPUTE
+}   request_t;
+
+#define REQUEST_WORDS ((sizeof(request_t) + sizeof(uint64_t) - 1) / sizeof(uint64_t))
+
+typedef struct { // seqlock of the last request, a single writer (the input thread)
+    uint32_t seq;                  // odd while the request is written (atomic)
+    uint64_t words[REQUEST_WORDS]; // the request word by word (atomic)
+}   request_lock_t;
 
 typedef struct { // shared date structure;
     int alarm_period;
@@ -30,53 +96,108 @@ typedef struct { // shared date structure;
     int fd; //forwarding
     int rd;// recieving
     bool is_serial_open; // if comunication established
-    bool abort;
     bool is_cond_signaled;
     bool is_message_recieved;
     pthread_mutex_t *mtx;
     pthread_cond_t *cond;
 
-    bool is_abort;
-
-
-    //set compute data
-    double c_re;
-    double c_im;
-    double d_re;
-    double d_im;
-    int n;
-
-
-    //computation data
-    uint8_t cid;
-    double re;
-    double im;
-    uint8_t n_re;
-    uint8_t n_im;
-
-
-
+    // the output thread alone writes into the pipe, every other thread
+    // encodes its messages into its own ring
+    ring_t reply;  // replies of the input thread
+    ring_t result; // results of the calculation thread
+    int ready;     // eventfd of the output thread
+    bool flushed;  // the producers have exited, the output thread quits when the rings are empty (atomic)
+    bool splice;   // --splice: the large batches go into the pipe by vmsplice(), write() otherwise
+
+
+    // the requests go from the input thread to the calculation thread without a
+    // lock, the mutex and the condition only wake the calculation thread up
+    request_t next;          // input thread only, built up by MSG_SET_COMPUTE and MSG_COMPUTE
+    request_lock_t request;  // the last MSG_COMPUTE, see publish_request()
+    uint32_t abort_gen;      // generation of the request stopped by MSG_ABORT (atomic)
+
+    // calculation thread only
+    julia_orbit *orbit; // perturbation reference, shared by all chunks of the frame
+    uint32_t frame;     // parameters of the orbit and the cache, renewed by the first chunk of a newer generation
+    // point symmetry J(-z) = J(z): the pixels are counted from the origin of the
+    // first chunk after new parameters, pixel (x, y) mirrors (mirror_x - x, mirror_y - y)
+    julia_dd frame_re;
+    julia_dd frame_im;
+    bool mirror;
+    int mirror_x;
+    int mirror_y;
+    chunk_cache_t cache[UINT8_MAX + 1]; // by cid
+    julia_kernel force_kernel; // --kernel, JULIA_KERNELS to select by the zoom depth
+    julia_kernel kernel; // of the last chunk computed, JULIA_KERNELS before the first (atomic, for MSG_STATS)
+    bool raw; // --raw: every pixel by MSG_COMPUTE_DATA as the reference module, not packed chunks
+    long corrupt; // requests dropped for a bad checksum or a missing byte
 }   data_t;
 
 void* input_thread(void*);
 void* calculation_thread(void*);
+void* output_thread(void*);
 
-message *buffer_parse(data_t *data, int message_type);
-bool send_message(data_t *data, message *msg);
+message *read_request(data_t *data, uint8_t *c);
+void publish_request(data_t *data);
+void take_request(data_t *data, request_t *req);
+bool send_message(ring_t *out, message *msg);
+int splice_all(int fd, const uint8_t *buf, int size);
 
-void compute_julia_set(data_t *data);
+bool compute_julia_set(data_t *data, const request_t *req);
+bool chunk_position(data_t *data, const julia_params_dd *p, int *x, int *y);
+int mirror_row(data_t *data, int x, int y, int w, uint8_t *row, bool *have);
+void abort_chunk(data_t *data);
+bool send_row(data_t *data, uint8_t cid, int y, int w, const uint8_t *row);
+bool send_packed(data_t *data, uint8_t cid, int w, int h, const uint8_t *iters);
+bool send_stats(data_t *data);
 
-#define CHUNK_SIZE_W 64
-#define CHUNK_SIZE_H 48
 
 int main(int argc, char *argv[])
 {
-   data_t data = { .alarm_period = 0, .alarm_counter = 0, .quit = false, .fd = EOF, .is_serial_open = false, .abort = false, .is_cond_signaled = false, .cid = 0, .re = 0, .im = 0, .n_re = 0, .n_im = 0, .is_message_recieved = false, .mtx = NULL, .cond = NULL, .c_re = 0, .c_im = 0, .d_re = 0, .d_im = 0, .n = 0};
+   data_t data = { .alarm_period = 0, .alarm_counter = 0, .quit = false, .fd = EOF, .is_serial_open = false, .is_cond_signaled = false, .is_message_recieved = false, .mtx = NULL, .cond = NULL, .next = { .frame = 1 }, .orbit = NULL, .frame = 0, .force_kernel = JULIA_KERNELS, .kernel = JULIA_KERNELS, .splice = false};
+
+   static const struct option options[] = {
+      { "kernel", required_argument, NULL, 'k' }, // A/B testing of the kernels
+      { "raw", no_argument, NULL, 'r' },
+      { "trace", required_argument, NULL, 't' },
+      { "affinity", required_argument, NULL, 'a' },
+      { "splice", no_argument, NULL, 's' }, // only batches of SPLICE_MIN_BYTES or more, none with 64x48 chunks
+      { "io", required_argument, NULL, 'i' },
+      { NULL, 0, NULL, 0 },
+   };
+   int opt;
+   const char *affinity = NULL; // PRGSEM_AFFINITY unless --affinity
+   const char *io = NULL;       // PRGSEM_IO unless --io
+   while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+      if (opt == 'k' && (data.force_kernel = julia_kernel_find(optarg)) < JULIA_KERNELS) {
+         continue;
+      } else if (opt == 'r') {
+         data.raw = true;
+         continue;
+      } else if (opt == 't') {
+         trace_open(optarg, "module");
+         continue;
+      } else if (opt == 'a') {
+         affinity = optarg;
+         continue;
+      } else if (opt == 's') {
+         data.splice = true;
+         continue;
+      } else if (opt == 'i') {
+         io = optarg;
+         continue;
+      }
+      fprintf(stderr, "usage: %s [--kernel float|double|dd|perturb|float128] [--raw] [--trace FILE] [--affinity off|auto|COMPUTE/IO] [--splice] [--io posix|uring]\n", argv[0]);
+      return EXIT_FAILURE;
+   }
+   if (!affinity_init(affinity) || !io_backend(io)) {
+      return EXIT_FAILURE;
+   }
 
-   enum { INPUT, CALCULATION, NUM_THREADS };
-   const char *threads_names[] = { "Input", "Calculation",};
+   enum { INPUT, CALCULATION, OUTPUT, NUM_THREADS };
+   const char *threads_names[] = { "Input", "Calculation", "Output",};
 
-   void* (*thr_functions[])(void*) = { input_thread, calculation_thread};
+   void* (*thr_functions[])(void*) = { input_thread, calculation_thread, output_thread};
 
    pthread_t threads[NUM_THREADS];
    pthread_mutex_t mtx;
@@ -85,6 +206,11 @@ int main(int argc, char *argv[])
    pthread_cond_init(&cond, NULL); // initialize condition variable with default attributes
    data.mtx = &mtx;                // make the mutex accessible from the shared data structure
    data.cond = &cond;              // make the cond accessible from the shared data structure
+   data.ready = ring_event();
+   if (data.ready < 0 || !ring_init_pages(&data.reply, BATCH_SIZE, data.ready) || !ring_init_pages(&data.result, BATCH_SIZE, data.ready)) {
+      fprintf(stderr, "ERROR: Unable to create the output rings\r\n");
+      return EXIT_FAILURE;
+   }
   
 
    call_termios(0);
@@ -97,12 +223,33 @@ int main(int argc, char *argv[])
 
    int *ex;
    for (int i = 0; i < NUM_THREADS; ++i) { // join threads so main doesnt end before threads
+      if (i == OUTPUT) { // nothing more comes into the rings, the output thread drains them and exits
+         __atomic_store_n(&data.flushed, true, __ATOMIC_SEQ_CST);
+         ring_wake(data.ready);
+      }
       printf("\033[1;35mTHREAD\033[0m: Call join to the thread %s\r\n", threads_names[i]);
       int r = pthread_join(threads[i], (void*)&ex);
       printf("\033[1;35mTHREAD\033[0m: Joining the thread %s has been %s - exit value %i\r\n", threads_names[i], (r == 0 ? "OK" : "FAIL"), *ex);
    }
 
    call_termios(1); // restore terminal settings
+   printf("INFO: %ld corrupted requests dropped\r\n", data.corrupt);
+   histo *h = malloc(sizeof(histo));
+   if (h) {
+      histo_collect(h);
+      histo_print(h, "module", stdout);
+      free(h);
+   }
+   if (!trace_close()) {
+      fprintf(stderr, "ERROR: Unable to write the trace\r\n");
+   }
+   julia_orbit_free(data.orbit);
+   ring_destroy(&data.reply);
+   ring_destroy(&data.result);
+   close(data.ready);
+   for (int i = 0; i <= UINT8_MAX; ++i) {
+      free(data.cache[i].iters);
+   }
    return EXIT_SUCCESS;
 }
 
@@ -112,6 +259,8 @@ void* input_thread(void* d)
 {
     data_t *data = (data_t*)d;
     static int r = 0;
+    trace_thread("input");
+    affinity_pin(AFFINITY_IO, 0, "input");
     // open comunication pipes
     data->fd = io_open_read(MY_DEVICE_OUT); // opens a named pipe
     if (data->fd == EOF){
@@ -126,16 +275,15 @@ void* input_thread(void* d)
 
     // wait for recieving startup message
     while(!data->quit){ 
-        uint8_t c;
-        io_getc_timeout(data->fd, 0,&c); 
-        if (c == MSG_STARTUP){
-            message *msg = buffer_parse(data, MSG_STARTUP);
+        uint8_t c = '\0';
+        message *msg = read_request(data, &c);
+        if (c == MSG_STARTUP && msg){
             printf("INFO: Startup: %s\r\n", msg->data.startup.message);
             free(msg);
-            c = '\0';
             break;
         }
-        else if (c == 'q'){
+        free(msg);
+        if (c == 'q'){
             data->quit = true;
             break;
         }
@@ -145,84 +293,98 @@ void* input_thread(void* d)
     while (!data->quit) {
         
         uint8_t c = '\0';
-        io_getc_timeout(data->fd, 0,&c); 
-        if (c == 'q'){
+        message *msg = read_request(data, &c);
+        if (c < MSG_NBR && msg == NULL){
+            continue; // nothing to read, or corrupted and answered by MSG_ERROR
+        }
+        else if (c == 'q'){
             data->quit = true;
             break;
         }    
         else if (c == MSG_GET_VERSION){//sends firmware info
             printf("INFO: sending version\r\n");
             //pthread_mutex_unlock(data->mtx);
-            message msg  = {.type = MSG_VERSION, .data.version = {'1','2','2'}};
-            if(!send_message(data,&msg))
-                exit(1);
-            fsync(data->rd);
+            message version = {.type = MSG_VERSION, .data.version = {'1','2','2'}};
+            send_message(&data->reply, &version);
            // pthread_mutex_lock(data->mtx);
         }
         else if (c == MSG_STARTUP){
             //pthread_mutex_unlock(data->mtx);
-            message *msg = buffer_parse(data, MSG_STARTUP);
             printf("INFO: Startup: %s\r\n", msg->data.startup.message);
-            free(msg);
             c = '\0';
             //pthread_mutex_lock(data->mtx);
         }
         else if (c == MSG_SET_COMPUTE){
             //pthread_mutex_unlock(data->mtx);
             printf("INFO: recieved set compute\r\n");
-            message *msg = buffer_parse(data, MSG_SET_COMPUTE);
-            data->c_re = msg->data.set_compute.c_re;
-            data->c_im = msg->data.set_compute.c_im;
-            data->d_re = msg->data.set_compute.d_re;
-            data->d_im = msg->data.set_compute.d_im;
-            data->n = msg->data.set_compute.n;
-
-
-            printf("c_re = %lf, c_im = %lf, d_re = %lf, d_im = %lf, n = %d\r\n", data->c_re, data->c_im, data->d_re, data->d_im, data->n);
+            julia_params_dd *p = &data->next.p; // published with the next MSG_COMPUTE
+            p->c_re = (julia_dd){msg->data.set_compute.c_re, 0};
+            p->c_im = (julia_dd){msg->data.set_compute.c_im, 0};
+            p->d_re = (julia_dd){msg->data.set_compute.d_re, 0};
+            p->d_im = (julia_dd){msg->data.set_compute.d_im, 0};
+            p->n = msg->data.set_compute.n;
+            data->next.frame += 1;
+            // the reference protocol gives no frame size, the escape radius bounds it
+            data->next.kernel = data->force_kernel < JULIA_KERNELS ? data->force_kernel : julia_select(p, 0, 0);
+
+
+            printf("c_re = %lf, c_im = %lf, d_re = %lf, d_im = %lf, n = %d\r\n", p->c_re.hi, p->c_im.hi, p->d_re.hi, p->d_im.hi, p->n);
             c = '\0';
-            free(msg);   
             //pthread_mutex_lock(data->mtx);
         }
+        else if (c == MSG_SET_COMPUTE_HP){
+            printf("INFO: recieved set compute (double-double)\r\n");
+            msg_set_compute_hp *m = &msg->data.set_compute_hp;
+            julia_params_dd *p = &data->next.p;
+            p->c_re = (julia_dd){m->c_re[0], m->c_re[1]};
+            p->c_im = (julia_dd){m->c_im[0], m->c_im[1]};
+            p->d_re = (julia_dd){m->d_re[0], m->d_re[1]};
+            p->d_im = (julia_dd){m->d_im[0], m->d_im[1]};
+            p->n = m->n;
+            data->next.frame += 1;
+            // the kernel prgsem-main chose for the whole frame, the same for every chunk
+            data->next.kernel = data->force_kernel < JULIA_KERNELS ? data->force_kernel : (m->kernel < JULIA_KERNELS ? m->kernel : julia_select(p, 0, 0));
+            printf("c_re = %lf, c_im = %lf, d_re = %g, d_im = %g, n = %d, %s kernel\r\n", p->c_re.hi, p->c_im.hi, p->d_re.hi, p->d_im.hi, p->n, julia_kernel_name(data->next.kernel));
+            c = '\0';
+        }
         else if (c == MSG_COMPUTE){
             //pthread_mutex_unlock(data->mtx);
             printf("INFO: recieved compute\r\n");
-            message *msg = buffer_parse(data, MSG_COMPUTE);
-            data->cid = msg->data.compute.cid;
-            data->re = msg->data.compute.re;
-            data->im = msg->data.compute.im;
-            data->n_re = msg->data.compute.n_re;
-            data->n_im = msg->data.compute.n_im;         
-            data->is_cond_signaled = true;
-            data->abort = false;
-            data->is_abort = false;
-            pthread_cond_broadcast(data->cond);
-
-            //pthread_mutex_lock(data->mtx);
-
+            data->next.cid = msg->data.compute.cid;
+            data->next.p.re = (julia_dd){msg->data.compute.re, 0};
+            data->next.p.im = (julia_dd){msg->data.compute.im, 0};
+            data->next.n_re = msg->data.compute.n_re;
+            data->next.n_im = msg->data.compute.n_im;
+            publish_request(data);
             c = '\0';
-            free(msg);
-
-            
+        }
+        else if (c == MSG_COMPUTE_HP){
+            printf("INFO: recieved compute (double-double)\r\n");
+            data->next.cid = msg->data.compute_hp.cid;
+            data->next.p.re = (julia_dd){msg->data.compute_hp.re[0], msg->data.compute_hp.re[1]};
+            data->next.p.im = (julia_dd){msg->data.compute_hp.im[0], msg->data.compute_hp.im[1]};
+            data->next.n_re = msg->data.compute_hp.n_re;
+            data->next.n_im = msg->data.compute_hp.n_im;
+            publish_request(data);
+            c = '\0';
+        }
+        else if (c == MSG_GET_STATS){
+            send_stats(data);
         }
         else if (c == MSG_ABORT){
             //printf("recieved end of computation\r\n");
-            data->abort = true;
-            pthread_mutex_unlock(data->mtx);
-            message *msg = buffer_parse(data, MSG_ABORT);
-            free(msg);
-            //pthread_mutex_lock(data->mtx);
+            __atomic_store_n(&data->abort_gen, data->next.gen, __ATOMIC_RELEASE); // the last request, running or not
             c = '\0';
 
         }
-            
+        free(msg);
     }
       
-    //pthread_mutex_unlock(data->mtx);
+    pthread_mutex_lock(data->mtx);
     data->quit = true;
     r = 1;
     pthread_cond_broadcast(data->cond);
-    
-    //pthread_mutex_unlock(data->mtx);
+    pthread_mutex_unlock(data->mtx);
     fprintf(stderr, "\033[1;35mTHREAD\033[0m: Exit input thread %lu\r\n", (unsigned long)pthread_self());
     return &r;
 }
@@ -230,108 +392,257 @@ void* input_thread(void* d)
 void* calculation_thread(void*d){
     data_t *data = (data_t*)d;
     static int r = 1;
+    trace_thread("calculation");
+    affinity_pin(AFFINITY_COMPUTE, 0, "calculation");
 
-    bool q = false;
-    pthread_mutex_lock(data->mtx);
-    while(!q){
-        //printf("INFO: Calculation thread is waiting\r\n");
-        while (!q && !data->is_cond_signaled) {
+    uint32_t taken = 0; // generation of the last request
+    while(true){
+        pthread_mutex_lock(data->mtx); // only to sleep until the next request
+        while (!data->quit && !data->is_cond_signaled) {
             pthread_cond_wait(data->cond, data->mtx);
-            q = data->quit;
         }
-        //printf("INFO: Calculation thread is running\r\n");
-        q = data->quit;
-        if(data->quit){
+        const bool q = data->quit;
+        data->is_cond_signaled = false; // request taken, the next one may come with MSG_DONE
+        pthread_mutex_unlock(data->mtx);
+        if(q){
             break;
         }
 
-        if (!data->abort && !q) {
-            // compute julia set for each chunk (64x48 pixels on 640 x 480 screen)
-            // send the result back to the input thread
-            double start_re = data->re;
-            double start_im = data->im;
-            while(!q){
-                
-                if(data->cid == 100){
-                    printf("INFO: Calculation thread is done\r\n");
-                    pthread_mutex_unlock(data->mtx);
-                    message msg = {.type = MSG_DONE};
-                    send_message(data, &msg);
-                    fsync(data->rd);
-                    pthread_mutex_lock(data->mtx);
-                    break;
-                }
+        request_t req;
+        take_request(data, &req);
+        if (req.gen != taken) {
+            // compute the requested chunk (n_re x n_im pixels from re, im)
+            // and report it by MSG_DONE, the same as the reference module
+            taken = req.gen;
+            if (__atomic_load_n(&data->abort_gen, __ATOMIC_ACQUIRE) == req.gen) {
+                abort_chunk(data); // aborted before it started, every request gets its answer
+            } else if(compute_julia_set(data, &req)){
+                message msg = {.type = MSG_DONE};
+                send_message(&data->result, &msg);
+            }
+        }
+    }
 
-                int chunk_width = 64;
-                int chunk_height = 48;
-                int chunks_per_row = 640 / chunk_width;
+    printf("INFO: Calculation thread is exiting\r\n");
+    return &r;
+}
 
-                int x_im = (data->cid % chunks_per_row) * chunk_width; //first chunk (real)
-                int y_im = (data->cid / chunks_per_row) * chunk_height; // forst chunk (imaginary)
+// publish data->next as the request of the next chunk and wake the calculation
+// thread; the seqlock has a single writer, the input thread
+void publish_request(data_t *data){
+    uint64_t words[REQUEST_WORDS] = {0};
+    data->next.gen += 1;
+    memcpy(words, &data->next, sizeof(request_t));
+    const uint32_t seq = data->request.seq;
+    __atomic_store_n(&data->request.seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE); // the odd seq before any word
+    for (int i = 0; i < REQUEST_WORDS; i++) {
+        __atomic_store_n(&data->request.words[i], words[i], __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&data->request.seq, seq + 2, __ATOMIC_RELEASE);
+    pthread_mutex_lock(data->mtx); // the calculation thread must not miss the signal
+    data->is_cond_signaled = true;
+    pthread_cond_broadcast(data->cond);
+    pthread_mutex_unlock(data->mtx);
+}
 
-                //printf("INFO: Chunk %d: x_im = %d, y_im = %d\r\n", data->cid, x_im, y_im);
-                data->re =start_re + x_im * data->d_re;
-                data->im = start_im + y_im * data->d_im;
-                //printf("INFO: Chunk %d: re = %lf, im = %lf\r\n", data->cid, data->re, data->im);                
+// copy of the last published request, retried while the input thread writes it
+void take_request(data_t *data, request_t *req){
+    uint64_t words[REQUEST_WORDS];
+    uint32_t seq;
+    do {
+        while ((seq = __atomic_load_n(&data->request.seq, __ATOMIC_ACQUIRE)) & 1) { }
+        for (int i = 0; i < REQUEST_WORDS; i++) {
+            words[i] = __atomic_load_n(&data->request.words[i], __ATOMIC_RELAXED);
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE); // the words before the second read of seq
+    } while (__atomic_load_n(&data->request.seq, __ATOMIC_RELAXED) != seq);
+    memcpy(req, words, sizeof(request_t));
+}
 
-                compute_julia_set(data);
-                if(data->is_abort){
-                    break;
-                }
-                data->cid++;
-                q = data->quit;
-            }
+// the message in one frame (see frame_seal()) into the ring of the calling thread
+bool send_message(ring_t *out, message *msg){
+   uint8_t *buf = ring_reserve(out);
+   int size;
+   fill_message_buf(msg, buf + FRAME_HEADER, sizeof(message), &size);
+   ring_commit(out, frame_seal(buf, size));
+   return true;
+}
+
+// release the batches prgsem-main has read (the bytes put into the pipe minus
+// the bytes still in it), all of them if it has closed the pipe
+static void recycle(data_t *data, output_t *out){
+    int queued = 0;
+    struct pollfd pfd = { .fd = data->rd };
+    if (out->n_flight > 0 && poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLERR)) {
+        queued = -1; // nothing is read any more
+    }
+    while (out->n_flight > 0) {
+        const in_flight_t *f = &out->flight[out->first];
+        if (queued >= 0 && (ioctl(data->rd, FIONREAD, &queued) != 0 || f->end > out->piped - queued)) {
+            break;
         }
+        ring_release(out->rings[f->ring]); // the slot is free
+        out->lent[f->ring] -= 1;
+        out->first = (out->first + 1) % OUT_BATCHES;
+        out->n_flight -= 1;
+    }
+}
 
-        data->is_cond_signaled = false;
-        q = data->quit;
+// a batch is in the pipe: its slot is released unless it is lent or a lent
+// batch of its ring is still ahead of it
+static void piped(output_t *out, int ring, int len, bool lent){
+    out->piped += len;
+    if (!lent && out->lent[ring] == 0) {
+        ring_release(out->rings[ring]);
+    } else {
+        out->flight[(out->first + out->n_flight++) % OUT_BATCHES] = (in_flight_t){ ring, out->piped };
+        out->lent[ring] += 1;
     }
-    pthread_mutex_unlock(data->mtx);
+}
 
-    printf("INFO: Calculation thread is exiting\r\n");
+// the gathered batches into the pipe, by one submission with the uring backend
+static void flush(data_t *data, output_t *out){
+    if (out->n == 0) {
+        return;
+    }
+    int bytes = 0;
+    for (int i = 0; i < out->n; i++) {
+        bytes += out->iov[i].iov_len;
+    }
+    const uint64_t s0 = TRACE_BEGIN();
+    const uint64_t t0 = HISTO_NOW();
+    if (out->ok && !io_write_batch(data->rd, out->iov, out->n)) { // the rest is dropped, the producers must not block
+        fprintf(stderr, "ERROR: Unable to write to the pipe\r\n");
+        out->ok = false;
+    }
+    HISTO_ADD(STAGE_WRITE, HISTO_NOW() - t0);
+    TRACE_END("batch write", s0, bytes);
+    for (int i = 0; i < out->n; i++) {
+        piped(out, out->from[i], out->iov[i].iov_len, false);
+    }
+    out->n = 0;
+}
+
+// the only writer of the pipe, drains the rings of the other threads and
+// sleeps on data->ready while they are empty. The batches ready are gathered
+// and written together (io_write_batch()); a large batch is lent to the pipe
+// by vmsplice() instead, its slot is released once prgsem-main has read it
+void* output_thread(void* d){
+    data_t *data = (data_t*)d;
+    static int r = 2;
+    trace_thread("output");
+    affinity_pin(AFFINITY_IO, 0, "output");
+    output_t out = { .rings = { &data->reply, &data->result }, .ok = true };
+    uint64_t spliced = 0;
+    struct iovec slots[2];
+    for (int i = 0; i < 2; i++) { // the slots are written over and over, registered once
+        slots[i] = (struct iovec){ out.rings[i]->slots, (size_t)RING_SLOTS * out.rings[i]->size };
+    }
+    io_register(slots, 2);
+    while (true) {
+        recycle(data, &out);
+        bool idle = true;
+        for (int i = 0; i < 2; i++) {
+            int len;
+            const uint8_t *buf;
+            while ((buf = ring_take(out.rings[i], &len)) != NULL) {
+                idle = false;
+                if (!out.ok || !data->splice || len < SPLICE_MIN_BYTES) {
+                    out.from[out.n] = i;
+                    out.iov[out.n++] = (struct iovec){ (void*)buf, len };
+                    continue;
+                }
+                flush(data, &out); // the pipe keeps the order of the batches
+                if (!out.enlarged) { // room for the lent pages, the default is 16 of them
+                    out.enlarged = true;
+                    if (fcntl(data->rd, F_SETPIPE_SZ, PIPE_BYTES) < 0) {
+                        fprintf(stderr, "WARNING: Unable to enlarge the pipe to %d bytes\r\n", PIPE_BYTES);
+                    }
+                }
+                const uint64_t s0 = TRACE_BEGIN();
+                const uint64_t t0 = HISTO_NOW();
+                int sent = splice_all(data->rd, buf, len);
+                data->splice = sent >= 0;
+                sent = sent < 0 ? 0 : sent;
+                spliced += sent;
+                if (!io_write_all(data->rd, buf + sent, len - sent)) {
+                    fprintf(stderr, "ERROR: Unable to write to the pipe\r\n");
+                    out.ok = false;
+                }
+                HISTO_ADD(STAGE_WRITE, HISTO_NOW() - t0);
+                TRACE_END("batch splice", s0, len);
+                piped(&out, i, len, sent > 0);
+            }
+        }
+        flush(data, &out);
+        if (idle) {
+            if (__atomic_load_n(&data->flushed, __ATOMIC_SEQ_CST)) {
+                break; // the pages still in the pipe stay valid, the kernel holds them
+            }
+            if (out.n_flight > 0) {
+                ring_wait_timeout(data->ready, RECYCLE_MS);
+            } else {
+                ring_wait(data->ready);
+            }
+        }
+    }
+    printf("INFO: %llu of %llu bytes spliced into the pipe\r\n", (unsigned long long)spliced, (unsigned long long)out.piped);
+    printf("INFO: Output thread is exiting\r\n");
     return &r;
 }
 
-bool send_message(data_t *data, message *msg){
-   uint8_t msg_buf[sizeof(message)];
-   int size;
-   fill_message_buf(msg, msg_buf,sizeof(message), &size);
-   pthread_mutex_lock(data->mtx);
-   int ret = write(data->rd, msg_buf, size);
-   pthread_mutex_unlock(data->mtx);
-   if(size != ret){
-        exit(1);
-   }
-   return size == ret;
+// lend the pages of buf to the pipe (the caller keeps them unchanged until they
+// are read); the bytes spliced, -1 if the pipe refuses it before the first one
+int splice_all(int fd, const uint8_t *buf, int size){
+    int done = 0;
+    while (done < size) {
+        struct iovec iov = { .iov_base = (void*)(buf + done), .iov_len = size - done };
+        ssize_t r = vmsplice(fd, &iov, 1, SPLICE_F_GIFT);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r <= 0) {
+            if (done == 0) {
+                fprintf(stderr, "WARNING: vmsplice() into the pipe failed (%s), the batches are copied\r\n", strerror(errno));
+                return -1;
+            }
+            break; // the rest by write()
+        }
+        done += r;
+    }
+    return done;
 }
 
-message *buffer_parse(data_t *data, int message_type){
-    uint8_t c = 0;
+// the next request of prgsem-main, c is its first byte ('\0' if none); NULL unless
+// it is a valid message - a corrupted one is answered by MSG_ERROR and the next
+// byte is taken as the start of the next message
+message *read_request(data_t *data, uint8_t *c){
     int len = 0;
     uint8_t msg_buf[sizeof(message)];
-    int i = 0;
-
-    get_message_size(message_type, &len);
-    msg_buf[i++] = message_type; // add the first byte 
-    while((i < len)){
-        io_getc_timeout(data->fd, 0, &c);
-        msg_buf[i++] = c;
+    if (io_getc_timeout(data->fd, 0, c) != 1 || !get_message_size(*c, &len)) {
+        return NULL;
+    }
+    const uint64_t s0 = TRACE_BEGIN();
+    msg_buf[0] = *c;
+    int i = 1;
+    while (i < len && io_getc_timeout(data->fd, REQUEST_TIMEOUT_MS, &msg_buf[i]) == 1) {
+        i++;
     }
     message *msg = malloc(sizeof(message));
     if(msg == NULL){
         fprintf(stderr, "ERROR: Unable to allocate memory\r\n");
         exit(1);
     }
-    msg->type = message_type;
-    get_message_size(message_type, &len);
-    if(!parse_message_buf(msg_buf, len, msg)){
-        fprintf(stderr, "ERROR: Unable to parse the message\r\n");
-        message msg2  = {.type = MSG_ERROR};
-        send_message(data,&msg2);
-        fsync(data->rd);
-        free(msg);  
-        exit(1);
-    } 
+    if(i < len || !parse_message_buf(msg_buf, len, msg)){
+        fprintf(stderr, "WARNING: Corrupted message %d dropped\r\n", *c);
+        data->corrupt += 1;
+        message error = {.type = MSG_ERROR};
+        send_message(&data->reply, &error);
+        free(msg);
+        return NULL;
+    }
+    TRACE_END("request", s0, *c);
     return msg;
 }
 
@@ -350,44 +661,171 @@ void call_termios(int reset)
 
 
 
-void compute_julia_set(data_t *data) {
-    
-    uint8_t iter;
-    double complex Z;
-    double complex C = data->c_re + data->c_im * I;
-    for (uint8_t x = 0; x <= CHUNK_SIZE_W; x++) { // for size of chunk 
-        for (uint8_t y = 0; y <= CHUNK_SIZE_H; y++) { // for size of chunk
-            Z = (data->re + x * data->d_re) + (data->im + y * data->d_im) * I; 
-            iter = 0;
-            while (cabs(Z) < 2 && iter < data->n) {
-                Z = Z * Z + C;
-                iter++;
-
+// the chunk of the request, the rows are sent as soon as they are computed;
+// false if it has been aborted (and MSG_ABORT sent instead of MSG_DONE)
+bool compute_julia_set(data_t *data, const request_t *req) {
+    const julia_params_dd p = req->p;
+    const julia_kernel kernel = req->kernel;
+    __atomic_store_n(&data->kernel, kernel, __ATOMIC_RELAXED);
+    const uint8_t cid = req->cid;
+    const int w = req->n_re;
+    const int h = req->n_im;
+    if (data->frame != req->frame) { // the first chunk after MSG_SET_COMPUTE is the origin of the frame
+        julia_orbit_free(data->orbit);
+        data->orbit = NULL;
+        data->frame_re = p.re;
+        data->frame_im = p.im;
+        data->mirror = julia_mirror(&p, &data->mirror_x, &data->mirror_y);
+        for (int i = 0; i <= UINT8_MAX; ++i) {
+            data->cache[i].valid = false;
+        }
+        data->frame = req->frame;
+    }
+    if (kernel == JULIA_PERTURB && data->orbit == NULL) {
+        // one reference orbit per MSG_SET_COMPUTE, at the centre of its first chunk
+        data->orbit = julia_orbit_create(&p, julia_coord(p.re, p.d_re, w / 2), julia_coord(p.im, p.d_im, h / 2));
+    }
+    const julia_orbit *orbit = data->orbit;
+    // the chunk is kept for its mirror, the cache is touched by this thread only
+    chunk_cache_t *cache = &data->cache[cid];
+    cache->valid = false;
+    const bool on_grid = chunk_position(data, &p, &cache->x, &cache->y);
+    if (cache->w * cache->h < w * h) {
+        free(cache->iters);
+        cache->iters = malloc(w * h);
+    }
+    cache->w = cache->iters ? w : 0;
+    cache->h = cache->iters ? h : 0;
+    const bool packed = !data->raw && cache->iters;
+    uint8_t row[UINT8_MAX + 1];
+    bool have[UINT8_MAX + 1];
+    int mirrored = 0;
+    uint64_t busy = 0; // time in the kernel, without the sending of the rows
+    const uint64_t s0 = TRACE_BEGIN();
+    for (int y = 0; y < h; y++) { // rows of the chunk
+        // pixels mirroring a cached chunk are copied, the runs between computed
+        const uint64_t t0 = HISTO_NOW();
+        const int n = on_grid && data->mirror ? mirror_row(data, cache->x, cache->y + y, w, row, have) : 0;
+        for (int x = 0; x < w; ) {
+            int run = 1;
+            while (x + run < w && (n == 0 || have[x + run] == have[x])) {
+                run++;
             }
-            if(data->abort){
-                pthread_mutex_unlock(data->mtx);
-                message msg = {.type = MSG_ABORT};
-                send_message(data, &msg);
-                fsync(data->rd);
-                data->is_cond_signaled = false;
-                data->is_abort = true;
-                pthread_mutex_lock(data->mtx);
-                return;
+            if (n == 0 || !have[x]) {
+                julia_compute_kernel(kernel, &p, orbit, x, y, run, 1, row + x, run);
             }
-            //printf("INFO: Chunk %d: x = %d, y = %d, iter = %d\r\n", data->cid, x, y, iter);
-            pthread_mutex_unlock(data->mtx);
-            message msg = {.type = MSG_COMPUTE_DATA, .data.compute_data = {data->cid, x, y, iter}}; // for each pixel = x, y in given chunk
-            send_message(data, &msg);
-            fsync(data->rd);
-            //printf("INFO: sent compute data\r\n");
-            pthread_mutex_lock(data->mtx);
+            x += run;
+        }
+        busy += HISTO_NOW() - t0;
+        mirrored += n;
+        if (cache->iters) {
+            memcpy(cache->iters + y * w, row, w);
+        }
+        if (__atomic_load_n(&data->abort_gen, __ATOMIC_ACQUIRE) == req->gen) {
+            abort_chunk(data);
+            return false;
+        }
+        if (!packed) { // otherwise the whole chunk is sent at the end
+            send_row(data, cid, y, w, row);
+        }
+    }
+    HISTO_ADD(STAGE_COMPUTE, busy);
+    TRACE_END("chunk compute", s0, cid); // with the raw rows encoded on the way
+    if (packed) {
+        send_packed(data, cid, w, h, cache->iters);
+    }
+    cache->valid = on_grid && cache->iters;
+    printf("INFO: Chunk %d is done (%s, %d pixels mirrored)\r\n", cid, julia_kernel_name(kernel), mirrored);
+    return true;
+}
 
+// stop the chunk on the abort request, a newer request is taken as usual
+void abort_chunk(data_t *data) {
+    message msg = {.type = MSG_ABORT};
+    send_message(&data->result, &msg);
+}
 
-        }
-        
+// the row as MSG_COMPUTE_DATA per pixel, all the frames in one batch of the ring
+bool send_row(data_t *data, uint8_t cid, int y, int w, const uint8_t *row) {
+    uint8_t *frame = ring_reserve(&data->result);
+    const uint64_t s0 = TRACE_BEGIN();
+    const uint64_t t0 = HISTO_NOW();
+    int size = 0;
+    for (int x = 0; x < w; x++) { // pixels of the row
+        message msg = {.type = MSG_COMPUTE_DATA, .data.compute_data = {cid, x, y, row[x]}}; // for each pixel = x, y in given chunk
+        int len;
+        fill_message_buf(&msg, frame + size + FRAME_HEADER, sizeof(message), &len);
+        size += frame_seal(frame + size, len);
     }
-    printf("INFO: Chunk %d is done\r\n", data->cid);
+    HISTO_ADD(STAGE_ENCODE, HISTO_NOW() - t0); // one sample per row of messages
+    TRACE_END("encode", s0, y);
+    ring_commit(&data->result, size);
+    return true;
+}
+
+// the chunk as one MSG_COMPUTE_DATA_PACKED with its payload, in a single frame
+bool send_packed(data_t *data, uint8_t cid, int w, int h, const uint8_t *iters) {
+    uint8_t *frame = ring_reserve(&data->result); // encoded in place
+    uint8_t *buf = frame + FRAME_HEADER;
+    const uint64_t s0 = TRACE_BEGIN();
+    const uint64_t t0 = HISTO_NOW();
+    int hdr;
+    get_message_size(MSG_COMPUTE_DATA_PACKED, &hdr);
+    const int len = pack_chunk(iters, w, h, w, buf + hdr, BATCH_SIZE - FRAME_HEADER - FRAME_TRAILER - hdr);
+    message msg = {.type = MSG_COMPUTE_DATA_PACKED, .data.compute_data_packed = {cid, w, h, len}};
+    fill_message_buf(&msg, buf, sizeof(message), &hdr);
+    const int size = frame_seal(frame, hdr + len);
+    HISTO_ADD(STAGE_ENCODE, HISTO_NOW() - t0);
+    TRACE_END("encode", s0, cid);
+    ring_commit(&data->result, size);
+    return true;
+}
+
+// the stage latencies of this process as MSG_STATS, called by the input thread
+bool send_stats(data_t *data) {
+    static histo h;
+    histo_collect(&h);
+    uint8_t *frame = ring_reserve(&data->reply);
+    int hdr;
+    get_message_size(MSG_STATS, &hdr);
+    uint8_t *buf = frame + FRAME_HEADER;
+    const int len = histo_pack(&h, buf + hdr, FRAME_MAX_BODY - hdr);
+    message msg = {.type = MSG_STATS, .data.stats = {len, __atomic_load_n(&data->kernel, __ATOMIC_RELAXED)}};
+    fill_message_buf(&msg, buf, sizeof(message), &hdr);
+    ring_commit(&data->reply, frame_seal(frame, hdr + len));
+    return true;
+}
 
+// position of the chunk in pixels from the origin of the frame, false if it is off the pixel grid
+bool chunk_position(data_t *data, const julia_params_dd *p, int *x, int *y) {
+    const double dx = ((p->re.hi - data->frame_re.hi) + (p->re.lo - data->frame_re.lo)) / p->d_re.hi;
+    const double dy = ((p->im.hi - data->frame_im.hi) + (p->im.lo - data->frame_im.lo)) / p->d_im.hi;
+    if (!(fabs(dx) < INT_MAX / 2 && fabs(dy) < INT_MAX / 2)) {
+        return false;
+    }
+    *x = lround(dx);
+    *y = lround(dy);
+    return fabs(dx - *x) < JULIA_MIRROR_EPS && fabs(dy - *y) < JULIA_MIRROR_EPS;
+}
 
-    
-}
\ No newline at end of file
+// pixels of the row y (from x on) whose mirror is in a cached chunk, have[] marks them
+int mirror_row(data_t *data, int x, int y, int w, uint8_t *row, bool *have) {
+    const int my = data->mirror_y - y;
+    int n = 0;
+    memset(have, 0, w * sizeof(bool));
+    for (int i = 0; i <= UINT8_MAX && n < w; i++) {
+        const chunk_cache_t *c = &data->cache[i];
+        if (!c->valid || my < c->y || my >= c->y + c->h) {
+            continue;
+        }
+        for (int k = 0; k < w; k++) {
+            const int mx = data->mirror_x - x - k;
+            if (!have[k] && mx >= c->x && mx < c->x + c->w) {
+                row[k] = c->iters[(my - c->y) * c->w + mx - c->x];
+                have[k] = true;
+                n++;
+            }
+        }
+    }
+    return n;
+}
@@ -0,0 +1,502 @@
+/*
+ * Filename: module_synth.c
+ * Date:     2026/10/19
+ *
+ * Synthetic load generator in place of ./module. It speaks the same protocol
+ * over the same pipes, but answers MSG_COMPUTE by made-up iteration counts
+ * at a configurable rate, burstiness and message mix without computing
+ * anything, so prgsem-main can be driven to its maximum ingest rate. What was
+ * sent is printed as one JSON object at exit.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <math.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <poll.h>
+
+#include "histo.h"
+#include "messages.h"
+#include "prg_io_nonblock.h"
+
+#define MY_DEVICE_OUT "/tmp/pipe.out"
+#define MY_DEVICE_IN "/tmp/pipe.in"
+
+#define REQUEST_TIMEOUT_MS 100 // the rest of a started request, the same as ./module
+#define IDLE_POLL_MS 100       // wait for a request when no chunk is being sent
+#define RATE_SLACK_S 0.05      // a rate limited sender catches up at most this much after a stall
+#define DEFAULT_N 60           // iterations until the first MSG_SET_COMPUTE
+
+typedef enum { ORDER_ROWS, ORDER_REVERSE, ORDER_RANDOM, ORDER_NBR } synth_order;
+typedef enum { VALUES_NOISE, VALUES_GRADIENT, VALUES_FLAT, VALUES_NBR } synth_values;
+
+static const char *order_names[] = { "rows", "reverse", "random" };
+static const char *values_names[] = { "noise", "gradient", "flat" };
+
+typedef struct {
+   int end;      // offset of the end of the message in the stream
+   long pixels;  // pixels of the chunk up to and including the message
+} synth_msg;
+
+typedef struct {
+   // options
+   double rate;          // pixels per second, 0 for the line rate
+   int burst;            // messages per write, 0 for a row of a raw chunk
+   int packed;           // percent of the chunks sent by one MSG_COMPUTE_DATA_PACKED
+   int corrupt;          // percent of the chunks with one corrupted message
+   synth_order order;    // order of the pixels of a raw chunk
+   synth_values values;  // iteration counts, noise does not pack at all
+   bool plain;           // messages without frames, as the reference module
+
+   int fd;               // requests of prgsem-main
+   int rd;               // the stream to prgsem-main
+   int n;                // iterations of MSG_SET_COMPUTE
+   uint32_t rnd;         // state of the mix, the same sequence in every run
+   bool quit;
+
+   // the chunk being sent, its messages are encoded at once
+   bool busy;
+   uint8_t *stream;
+   int size;
+   int pos;              // bytes written so far
+   synth_msg *msgs;
+   int cap;              // messages allocated
+   int count;
+   int next;             // the first message not written yet
+   int w;                // pixels per row of the chunk
+   uint8_t *iters;
+   int *perm;
+   double t_next;        // the earliest time of the next write, rate limited only
+
+   // report
+   long chunks;
+   long packed_chunks;
+   long corrupted;
+   long aborted;
+   long messages;
+   long pixels;
+   long bytes;
+   long writes;
+   long requests;
+   long bad_requests;
+   double t_first;       // first MSG_COMPUTE
+   double t_last;        // MSG_DONE of the last chunk
+   double write_s;       // time in write(), the pipe is full while prgsem-main lags
+} synth_t;
+
+// - function -----------------------------------------------------------------
+static double get_time(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// - function -----------------------------------------------------------------
+static uint32_t next_rnd(uint32_t *x)
+{
+   *x ^= *x << 13; // xorshift32
+   *x ^= *x >> 17;
+   *x ^= *x << 5;
+   return *x;
+}
+
+// - function -----------------------------------------------------------------
+static int find_name(const char *names[], int count, const char *name)
+{
+   int i = 0;
+   while (i < count && strcmp(names[i], name)) {
+      ++i;
+   }
+   return i;
+}
+
+// - function -----------------------------------------------------------------
+static bool reserve(synth_t *s, int bytes, int msgs)
+{
+   if (s->pos + bytes > s->size) {
+      const int size = 2 * (s->pos + bytes);
+      uint8_t *b = realloc(s->stream, size);
+      if (b == NULL) {
+         return false;
+      }
+      s->stream = b;
+      s->size = size;
+   }
+   if (s->count + msgs > s->cap) {
+      const int cap = 2 * (s->count + msgs);
+      synth_msg *m = realloc(s->msgs, cap * sizeof(synth_msg));
+      if (m == NULL) {
+         return false;
+      }
+      s->msgs = m;
+      s->cap = cap;
+   }
+   return true;
+}
+
+// - function -----------------------------------------------------------------
+// append the message and its payload to the stream, framed unless --plain;
+// s->pos is the end of the stream while a chunk is encoded
+static bool put_message(synth_t *s, const message *msg, const uint8_t *payload, int len, int pixels)
+{
+   int size;
+   get_message_size(msg->type, &size);
+   if (!reserve(s, FRAME_HEADER + size + len + FRAME_TRAILER, 1)) {
+      return false;
+   }
+   uint8_t *buf = s->stream + s->pos;
+   uint8_t *body = s->plain ? buf : buf + FRAME_HEADER;
+   fill_message_buf(msg, body, sizeof(message), &size);
+   memcpy(body + size, payload, len);
+   s->pos += s->plain ? size + len : frame_seal(buf, size + len);
+   const long before = s->count ? s->msgs[s->count - 1].pixels : 0;
+   s->msgs[s->count++] = (synth_msg){ s->pos, before + pixels };
+   return true;
+}
+
+// - function -----------------------------------------------------------------
+static void make_iters(synth_t *s, int cid, int w, int h)
+{
+   uint32_t x = 0x9e3779b9u * (cid + 1); // the same counts for the same chunk in every frame
+   for (int i = 0; i < w * h; ++i) {
+      switch (s->values) {
+         case VALUES_FLAT:
+            s->iters[i] = s->n;
+            break;
+         case VALUES_GRADIENT:
+            s->iters[i] = (i % w + i / w + cid) % (s->n + 1);
+            break;
+         default:
+            s->iters[i] = next_rnd(&x) % (s->n + 1);
+      }
+   }
+}
+
+// - function -----------------------------------------------------------------
+static void make_order(synth_t *s, int count)
+{
+   for (int i = 0; i < count; ++i) {
+      s->perm[i] = s->order == ORDER_REVERSE ? count - 1 - i : i;
+   }
+   if (s->order == ORDER_RANDOM) { // Fisher-Yates
+      for (int i = count - 1; i > 0; --i) {
+         const int j = next_rnd(&s->rnd) % (i + 1);
+         const int t = s->perm[i];
+         s->perm[i] = s->perm[j];
+         s->perm[j] = t;
+      }
+   }
+}
+
+// - function -----------------------------------------------------------------
+// encode the whole answer to MSG_COMPUTE, its data and MSG_DONE
+static bool start_chunk(synth_t *s, uint8_t cid, int w, int h)
+{
+   static uint8_t payload[PACKED_MAX_SIZE(UINT8_MAX, UINT8_MAX)];
+   s->pos = s->count = s->next = 0;
+   s->w = w;
+   make_iters(s, cid, w, h);
+   bool ok = true;
+   if (next_rnd(&s->rnd) % 100 < s->packed) {
+      const int len = pack_chunk(s->iters, w, h, w, payload, sizeof(payload));
+      message msg = { .type = MSG_COMPUTE_DATA_PACKED, .data.compute_data_packed = { cid, w, h, len } };
+      ok = put_message(s, &msg, payload, len, w * h);
+      s->packed_chunks += 1;
+   } else {
+      make_order(s, w * h);
+      for (int i = 0; ok && i < w * h; ++i) {
+         const int p = s->perm[i];
+         message msg = { .type = MSG_COMPUTE_DATA, .data.compute_data = { cid, p % w, p / w, s->iters[p] } };
+         ok = put_message(s, &msg, NULL, 0, 1);
+      }
+   }
+   message done = { .type = MSG_DONE };
+   ok = ok && put_message(s, &done, NULL, 0, 0);
+   if (ok && s->count > 1 && next_rnd(&s->rnd) % 100 < s->corrupt) {
+      // one bit of a data message flipped, prgsem-main has to drop it and ask for the chunk again
+      const int m = next_rnd(&s->rnd) % (s->count - 1);
+      const int start = m ? s->msgs[m - 1].end : 0;
+      s->stream[start + (s->plain ? 1 : FRAME_HEADER + 1)] ^= 0x10;
+      s->corrupted += 1;
+   }
+   s->pos = 0;
+   s->busy = ok;
+   if (!ok) {
+      fprintf(stderr, "\033[1;31mERROR\033[0m: Unable to allocate memory for chunk %d\r\n", cid);
+   }
+   return ok;
+}
+
+// - function -----------------------------------------------------------------
+// the next burst of the chunk by one write
+static bool send_burst(synth_t *s)
+{
+   // by default a row of a raw chunk per write, the same as ./module --raw
+   const int burst = s->burst > 0 ? s->burst : s->msgs[0].pixels > 1 ? 1 : s->w;
+   const int last = s->next + burst < s->count ? s->next + burst : s->count;
+   const int end = s->msgs[last - 1].end;
+   const long pixels = s->msgs[last - 1].pixels - (s->next ? s->msgs[s->next - 1].pixels : 0);
+   const uint64_t t0 = histo_now();
+   const bool ok = io_write_all(s->rd, s->stream + s->pos, end - s->pos);
+   const uint64_t dt = histo_now() - t0;
+   HISTO_ADD(STAGE_WRITE, dt);
+   s->write_s += dt * 1e-9;
+   s->writes += 1;
+   s->bytes += end - s->pos;
+   s->messages += last - s->next;
+   s->pixels += pixels;
+   s->pos = end;
+   s->next = last;
+   if (s->rate > 0) {
+      const double t = get_time();
+      if (s->t_next < t - RATE_SLACK_S) {
+         s->t_next = t - RATE_SLACK_S;
+      }
+      s->t_next += pixels / s->rate;
+   }
+   if (s->next == s->count) {
+      s->busy = false;
+      s->chunks += 1;
+      s->t_last = get_time();
+   }
+   return ok;
+}
+
+// - function -----------------------------------------------------------------
+static bool send_message(synth_t *s, const message *msg)
+{
+   uint8_t buf[FRAME_HEADER + sizeof(message) + FRAME_TRAILER];
+   uint8_t *body = s->plain ? buf : buf + FRAME_HEADER;
+   int size;
+   fill_message_buf(msg, body, sizeof(message), &size);
+   if (!s->plain) {
+      size = frame_seal(buf, size);
+   }
+   return io_write_all(s->rd, buf, size);
+}
+
+// - function -----------------------------------------------------------------
+// the stage latencies of this process as MSG_STATS, only the writes are measured
+static bool send_stats(synth_t *s)
+{
+   static uint8_t frame[FRAME_HEADER + FRAME_MAX_BODY + FRAME_TRAILER];
+   static histo h;
+   histo_collect(&h);
+   int hdr;
+   get_message_size(MSG_STATS, &hdr);
+   uint8_t *buf = s->plain ? frame : frame + FRAME_HEADER;
+   const int len = histo_pack(&h, buf + hdr, FRAME_MAX_BODY - hdr);
+   message msg = { .type = MSG_STATS, .data.stats = { len, UINT8_MAX } }; // no kernel
+   fill_message_buf(&msg, buf, sizeof(message), &hdr);
+   const int size = s->plain ? hdr + len : frame_seal(frame, hdr + len);
+   return io_write_all(s->rd, frame, size);
+}
+
+// - function -----------------------------------------------------------------
+// the next request within timeout_ms, c is its first byte ('\0' if none);
+// false unless msg holds a valid message
+static bool read_request(synth_t *s, int timeout_ms, uint8_t *c, message *msg)
+{
+   struct pollfd p = { .fd = s->fd, .events = POLLIN };
+   *c = '\0';
+   if (poll(&p, 1, timeout_ms) <= 0) {
+      return false;
+   }
+   if (!(p.revents & POLLIN)) { // prgsem-main has gone without 'q'
+      s->quit = p.revents & (POLLHUP | POLLERR);
+      return false;
+   }
+   int len;
+   uint8_t buf[sizeof(message)];
+   if (io_getc_timeout(s->fd, 0, c) != 1 || !get_message_size(*c, &len)) {
+      return false;
+   }
+   buf[0] = *c;
+   int i = 1;
+   while (i < len && io_getc_timeout(s->fd, REQUEST_TIMEOUT_MS, &buf[i]) == 1) {
+      i++;
+   }
+   s->requests += 1;
+   if (i < len || !parse_message_buf(buf, len, msg)) {
+      fprintf(stderr, "\033[1;33mWARNING\033[0m: Corrupted request %d dropped\r\n", *c);
+      s->bad_requests += 1;
+      message error = { .type = MSG_ERROR };
+      send_message(s, &error);
+      return false;
+   }
+   return true;
+}
+
+// - function -----------------------------------------------------------------
+static bool handle_request(synth_t *s, uint8_t c, const message *msg)
+{
+   bool ok = true;
+   if (c == 'q') {
+      s->quit = true;
+   } else if (c == MSG_GET_VERSION) {
+      message version = { .type = MSG_VERSION, .data.version = { '1', '2', '2' } };
+      ok = send_message(s, &version);
+   } else if (c == MSG_SET_COMPUTE) {
+      s->n = msg->data.set_compute.n;
+   } else if (c == MSG_SET_COMPUTE_HP) {
+      s->n = msg->data.set_compute_hp.n;
+   } else if (c == MSG_COMPUTE || c == MSG_COMPUTE_HP) {
+      const bool hp = c == MSG_COMPUTE_HP;
+      if (s->busy) { // a new request replaces the one being sent, as in ./module
+         s->aborted += 1;
+      }
+      if (s->t_first == 0) {
+         s->t_first = s->t_next = get_time();
+      }
+      start_chunk(s, hp ? msg->data.compute_hp.cid : msg->data.compute.cid,
+            hp ? msg->data.compute_hp.n_re : msg->data.compute.n_re,
+            hp ? msg->data.compute_hp.n_im : msg->data.compute.n_im);
+   } else if (c == MSG_ABORT && s->busy) {
+      s->busy = false;
+      s->aborted += 1;
+      message abort = { .type = MSG_ABORT };
+      ok = send_message(s, &abort);
+   } else if (c == MSG_GET_STATS) {
+      ok = send_stats(s);
+   }
+   return ok;
+}
+
+// - function -----------------------------------------------------------------
+static void print_report(const synth_t *s)
+{
+   const double wall = s->t_last > s->t_first ? s->t_last - s->t_first : 0;
+   printf("{\"module\": \"synth\", \"rate\": %.0f, \"burst\": %d, \"packed_pct\": %d, \"corrupt_pct\": %d, "
+         "\"order\": \"%s\", \"values\": \"%s\", \"plain\": %s, "
+         "\"wall_s\": %.6f, \"chunks\": %ld, \"packed_chunks\": %ld, \"corrupted\": %ld, \"aborted\": %ld, "
+         "\"messages\": %ld, \"pixels\": %ld, \"pixels_per_s\": %.1f, \"bytes\": %ld, \"mb_per_s\": %.3f, "
+         "\"writes\": %ld, \"write_s\": %.6f, \"write_share\": %.3f, \"requests\": %ld, \"bad_requests\": %ld}\n",
+         s->rate, s->burst, s->packed, s->corrupt, order_names[s->order], values_names[s->values], s->plain ? "true" : "false",
+         wall, s->chunks, s->packed_chunks, s->corrupted, s->aborted,
+         s->messages, s->pixels, wall > 0 ? s->pixels / wall : 0, s->bytes, wall > 0 ? s->bytes / wall * 1e-6 : 0,
+         s->writes, s->write_s, wall > 0 ? s->write_s / wall : 0, s->requests, s->bad_requests);
+}
+
+// - main function ------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+   synth_t s = { .packed = 100, .n = DEFAULT_N, .rnd = 2463534242u };
+   static const struct option options[] = {
+      { "rate", required_argument, NULL, 'r' },
+      { "burst", required_argument, NULL, 'b' },
+      { "packed", required_argument, NULL, 'k' },
+      { "corrupt", required_argument, NULL, 'c' },
+      { "order", required_argument, NULL, 'o' },
+      { "values", required_argument, NULL, 'v' },
+      { "plain", no_argument, NULL, 'p' },
+      { "io", required_argument, NULL, 'i' },
+      { NULL, 0, NULL, 0 },
+   };
+   int opt;
+   bool ok = true;
+   const char *io = NULL; // PRGSEM_IO unless --io
+   while (ok && (opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+      switch (opt) {
+         case 'r':
+            ok = (s.rate = atof(optarg)) >= 0;
+            break;
+         case 'b':
+            ok = (s.burst = atoi(optarg)) >= 0;
+            break;
+         case 'k':
+            ok = (s.packed = atoi(optarg)) >= 0 && s.packed <= 100;
+            break;
+         case 'c':
+            ok = (s.corrupt = atoi(optarg)) >= 0 && s.corrupt <= 100;
+            break;
+         case 'o':
+            ok = (s.order = find_name(order_names, ORDER_NBR, optarg)) < ORDER_NBR;
+            break;
+         case 'v':
+            ok = (s.values = find_name(values_names, VALUES_NBR, optarg)) < VALUES_NBR;
+            break;
+         case 'p':
+            s.plain = true;
+            break;
+         case 'i':
+            io = optarg;
+            break;
+         default:
+            ok = false;
+      }
+   }
+   if (!ok || optind < argc || !io_backend(io)) {
+      fprintf(stderr, "usage: %s [--rate PIXELS/S] [--burst MESSAGES] [--packed PCT] [--corrupt PCT]\n"
+            "          [--order rows|reverse|random] [--values noise|gradient|flat] [--plain] [--io posix|uring]\n", argv[0]);
+      return EXIT_FAILURE;
+   }
+   s.iters = malloc(UINT8_MAX * UINT8_MAX);
+   s.perm = malloc(UINT8_MAX * UINT8_MAX * sizeof(int));
+   if (s.iters == NULL || s.perm == NULL) {
+      fprintf(stderr, "\033[1;31mERROR\033[0m: Unable to allocate memory\n");
+      return EXIT_FAILURE;
+   }
+   signal(SIGPIPE, SIG_IGN); // prgsem-main may go first, the write fails and the report is still printed
+
+   s.fd = io_open_read(MY_DEVICE_OUT);
+   if (s.fd == EOF) {
+      fprintf(stderr, "\033[1;31mERROR\033[0m: Unable to open the file %s\n", MY_DEVICE_OUT);
+      return EXIT_FAILURE;
+   }
+   s.rd = io_open_write(MY_DEVICE_IN);
+   if (s.rd == EOF) {
+      fprintf(stderr, "\033[1;31mERROR\033[0m: Unable to open the file %s\n", MY_DEVICE_IN);
+      return EXIT_FAILURE;
+   }
+   fprintf(stderr, "\033[1;34mINFO\033[0m: Synthetic module, %s stream at %s\n", s.plain ? "plain" : "framed", s.rate > 0 ? "a limited rate" : "the line rate");
+
+   while (!s.quit) { // the startup message first, the same as ./module
+      uint8_t c;
+      message msg;
+      if (read_request(&s, IDLE_POLL_MS, &c, &msg) && c == MSG_STARTUP) {
+         break;
+      }
+      s.quit = s.quit || c == 'q';
+   }
+   while (!s.quit && ok) {
+      int timeout = s.busy ? 0 : IDLE_POLL_MS;
+      if (s.busy && s.rate > 0) { // wait for requests until the next burst is due
+         const double wait = s.t_next - get_time();
+         timeout = wait > 0 ? (int)ceil(wait * 1e3) : 0;
+      }
+      uint8_t c;
+      message msg;
+      if (read_request(&s, timeout, &c, &msg) || c == 'q') {
+         ok = handle_request(&s, c, &msg);
+      } else if (s.busy && (s.rate == 0 || get_time() >= s.t_next)) {
+         ok = send_burst(&s);
+      }
+   }
+   if (!ok) {
+      fprintf(stderr, "\033[1;31mERROR\033[0m: Unable to write to the pipe\n");
+   }
+   histo *h = malloc(sizeof(histo));
+   if (h) {
+      histo_collect(h);
+      histo_print(h, "module-synth", stderr);
+      free(h);
+   }
+   print_report(&s);
+   free(s.stream);
+   free(s.msgs);
+   free(s.iters);
+   free(s.perm);
+   io_close(s.fd);
+   io_close(s.rd);
+   return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* end of module_synth.c */
@@ -0,0 +1,159 @@
+/*
+ * Filename: perturb.c
+ * Date:     2026/10/19
+ *
+ * Perturbation kernel of libjulia - the pixels iterate double precision
+ * deltas from one bignum reference orbit (see julia_orbit_create).
+ */
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "bignum.h"
+#include "julia.h"
+#include "julia_dd.h"
+
+#define ORBIT_GUARD_BITS 64  // fraction bits of the orbit below the pixel spacing
+
+enum { ORBIT_REF, ORBIT_CRIT, ORBITS };
+
+struct julia_orbit {
+   julia_dd re;          // reference point
+   julia_dd im;
+   int len[ORBITS];      // stored points, the last one escaped or is Z_n
+   double *zr[ORBITS];
+   double *zi[ORBITS];
+};
+
+// - function -----------------------------------------------------------------
+static int orbit_limbs(const julia_params_dd *p)
+{
+   const double d = fmin(fabs(p->d_re.hi), fabs(p->d_im.hi));
+   const int bits = (d > 0 ? -ilogb(d) : 0) + ORBIT_GUARD_BITS;
+   const int n = 1 + (bits + 31) / 32; // integer limb + fraction
+   return n < 3 ? 3 : (n > BN_LIMBS ? BN_LIMBS : n);
+}
+
+// - function -----------------------------------------------------------------
+static void bn_from_dd(bignum *r, julia_dd x, int n)
+{
+   bignum lo;
+   bn_from_double(r, x.hi, n);
+   bn_from_double(&lo, x.lo, n);
+   bn_add(r, r, &lo, n);
+}
+
+// - function -----------------------------------------------------------------
+static int orbit_fill(double *zr, double *zi, bignum xr, bignum xi, const bignum *c_re, const bignum *c_im, int iter, int n)
+{
+   int len = 0;
+   while (true) {
+      zr[len] = bn_to_double(&xr, n);
+      zi[len] = bn_to_double(&xi, n);
+      if (++len > iter || zr[len - 1] * zr[len - 1] + zi[len - 1] * zi[len - 1] >= 4) {
+         break;
+      }
+      bignum r2, i2, ri;
+      bn_mul(&r2, &xr, &xr, n);
+      bn_mul(&i2, &xi, &xi, n);
+      bn_mul(&ri, &xr, &xi, n);
+      bn_sub(&xr, &r2, &i2, n);
+      bn_add(&xr, &xr, c_re, n);
+      bn_add(&xi, &ri, &ri, n);
+      bn_add(&xi, &xi, c_im, n);
+   }
+   return len;
+}
+
+// - function -----------------------------------------------------------------
+julia_orbit *julia_orbit_create(const julia_params_dd *p, julia_dd re, julia_dd im)
+{
+   julia_orbit *o = calloc(1, sizeof(julia_orbit));
+   if (o == NULL) {
+      return NULL;
+   }
+   for (int i = 0; i < ORBITS; ++i) {
+      o->zr[i] = malloc((p->n + 1) * sizeof(double));
+      o->zi[i] = malloc((p->n + 1) * sizeof(double));
+      if (!o->zr[i] || !o->zi[i]) {
+         julia_orbit_free(o);
+         return NULL;
+      }
+   }
+   o->re = re;
+   o->im = im;
+   const int n = orbit_limbs(p);
+   bignum c_re, c_im, zr, zi;
+   bn_from_dd(&c_re, p->c_re, n);
+   bn_from_dd(&c_im, p->c_im, n);
+   bn_from_dd(&zr, re, n);
+   bn_from_dd(&zi, im, n);
+   o->len[ORBIT_REF] = orbit_fill(o->zr[ORBIT_REF], o->zi[ORBIT_REF], zr, zi, &c_re, &c_im, p->n, n);
+   bn_from_double(&zr, 0, n);
+   bn_from_double(&zi, 0, n);
+   o->len[ORBIT_CRIT] = orbit_fill(o->zr[ORBIT_CRIT], o->zi[ORBIT_CRIT], zr, zi, &c_re, &c_im, p->n, n);
+   return o;
+}
+
+// - function -----------------------------------------------------------------
+void julia_orbit_free(julia_orbit *o)
+{
+   if (o == NULL) {
+      return;
+   }
+   for (int i = 0; i < ORBITS; ++i) {
+      free(o->zr[i]);
+      free(o->zi[i]);
+   }
+   free(o);
+}
+
+// - function -----------------------------------------------------------------
+static inline int perturb_point(const julia_orbit *o, double dr, double di, int n)
+{
+   const double *zr = o->zr[ORBIT_REF];
+   const double *zi = o->zi[ORBIT_REF];
+   int len = o->len[ORBIT_REF];
+   int m = 0;
+   int k = 0;
+   for (; k < n; ++k) {
+      const double r = zr[m] + dr;
+      const double i = zi[m] + di;
+      const double r2 = r * r + i * i;
+      if (r2 >= 4) {
+         break;
+      }
+      if (r2 < dr * dr + di * di || m == len - 1) {
+         // z is nearer to 0 than to the orbit, or the orbit ended: continue
+         // from the critical orbit 0, c, c^2 + c, ... with the delta d = z
+         zr = o->zr[ORBIT_CRIT];
+         zi = o->zi[ORBIT_CRIT];
+         len = o->len[ORBIT_CRIT];
+         m = 0;
+         dr = r;
+         di = i;
+      }
+      // z' = (Z + d)^2 + c = Z' + 2 Z d + d^2
+      const double t = 2 * (zr[m] * dr - zi[m] * di) + dr * dr - di * di;
+      di = 2 * (zr[m] * di + zi[m] * dr) + 2 * dr * di;
+      dr = t;
+      ++m;
+   }
+   return k;
+}
+
+// - function -----------------------------------------------------------------
+void julia_compute_perturb(const julia_orbit *o, const julia_params_dd *p, int x0, int y0, int w, int h, uint8_t *out, int stride)
+{
+   // the deltas are differences of double-double coordinates, only the
+   // iteration itself is in double
+   for (int y = 0; y < h; ++y) {
+      const double di = dd_add(julia_coord(p->im, p->d_im, y0 + y), dd_neg(o->im)).hi;
+      for (int x = 0; x < w; ++x) {
+         const double dr = dd_add(julia_coord(p->re, p->d_re, x0 + x), dd_neg(o->re)).hi;
+         out[y * stride + x] = perturb_point(o, dr, di, p->n);
+      }
+   }
+}
+
+/* end of perturb.c */
@@ -8,11 +8,45 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <termios.h>
 
 #include <poll.h>
 
 #include "prg_io_nonblock.h"
+#include "uring.h"
+
+static bool uring; // the io_uring backend
+
+/// ----------------------------------------------------------------------------
+bool io_backend(const char *name)
+{
+   if (name == NULL) {
+      name = getenv(IO_BACKEND_ENV);
+   }
+   if (name == NULL || *name == '\0' || strcmp(name, "posix") == 0) {
+      uring = false;
+      return true;
+   }
+   if (strcmp(name, "uring") != 0) {
+      fprintf(stderr, "\033[1;31mERROR\033[0m: Unknown I/O backend '%s', use posix or uring\r\n", name);
+      return false;
+   }
+   uring = uring_probe();
+   if (uring) {
+      fprintf(stderr, "\033[1;34mIO\033[0m: io_uring backend\r\n");
+   } else {
+      fprintf(stderr, "\033[1;33mWARNING\033[0m: io_uring is not supported, the posix I/O is used\r\n");
+   }
+   return true;
+}
+
+/// ----------------------------------------------------------------------------
+const char *io_backend_name(void)
+{
+   return uring ? "uring" : "posix";
+}
 
 /// ----------------------------------------------------------------------------
 static int io_open(const char *fname, int flag)
@@ -53,14 +87,18 @@ int io_close(int fd)
 /// ----------------------------------------------------------------------------
 int io_putc(int fd, char c)
 {
-   return write(fd, &c, 1);
+   const int r = uring ? uring_write(fd, &c, 1) : URING_NONE;
+   return r != URING_NONE ? r : write(fd, &c, 1);
 }
 
 /// ----------------------------------------------------------------------------
 int io_getc(int fd)
 {
    char c;
-   int r = read(fd, &c, 1);
+   int r = uring ? uring_getc_timeout(fd, -1, (unsigned char*)&c) : URING_NONE;
+   if (r == URING_NONE) {
+      r = read(fd, &c, 1);
+   }
    return r == 1 ? c : -1;
 }
 
@@ -68,7 +106,11 @@ int io_getc(int fd)
 int io_getc_timeout(int fd, int timeout_ms, unsigned char *c)
 {
    struct pollfd ufdr[1];
-   int r = 0;
+   int r = uring ? uring_getc_timeout(fd, timeout_ms, c) : URING_NONE;
+   if (r != URING_NONE) { // the read and its timeout by one system call
+      return r;
+   }
+   r = 0;
    ufdr[0].fd = fd;
    ufdr[0].events = POLLIN | POLLRDNORM;
    if ((poll(&ufdr[0], 1, timeout_ms) > 0) && (ufdr[0].revents & (POLLIN | POLLRDNORM))) {
@@ -77,4 +119,44 @@ int io_getc_timeout(int fd, int timeout_ms, unsigned char *c)
    return r;
 }
 
+/// ----------------------------------------------------------------------------
+bool io_write_all(int fd, const void *buf, int size)
+{
+   const struct iovec iov = { .iov_base = (void*)buf, .iov_len = size };
+   return io_write_batch(fd, &iov, 1);
+}
+
+/// ----------------------------------------------------------------------------
+bool io_write_batch(int fd, const struct iovec *iov, int n)
+{
+   int done[n > 0 ? n : 1];
+   memset(done, 0, sizeof(done));
+   const int r = uring ? uring_write_batch(fd, iov, n, done) : URING_NONE;
+   if (r == 0) {
+      return false;
+   }
+   for (int i = 0; i < n; ++i) { // everything with posix, the short and cancelled writes of uring
+      const char *p = (const char*)iov[i].iov_base + done[i];
+      int size = (int)iov[i].iov_len - done[i];
+      while (size > 0) {
+         ssize_t w = write(fd, p, size);
+         if (w < 0 && errno == EINTR) {
+            continue;
+         }
+         if (w <= 0) {
+            return false;
+         }
+         p += w;
+         size -= w;
+      }
+   }
+   return true;
+}
+
+/// ----------------------------------------------------------------------------
+bool io_register(const struct iovec *iov, int n)
+{
+   return uring && uring_register(iov, n) == 1;
+}
+
 /* end of prg_io_nonblock.c */
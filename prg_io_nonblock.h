@@ -7,6 +7,29 @@
 #ifndef __PRG_IO_NONBLOCK_H__
 #define __PRG_IO_NONBLOCK_H__
 
+#include <stdbool.h>
+
+#include <sys/uio.h>
+
+#define IO_BACKEND_ENV "PRGSEM_IO"
+
+/// ----------------------------------------------------------------------------
+/// @brief io_backend -- select the I/O behind the functions below, call it
+/// before the threads start
+///
+/// @param name -- posix (poll(), read() and write()), or uring (io_uring,
+///                posix if the kernel does not support it); NULL for the value
+///                of PRGSEM_IO, posix if it is not set
+///
+/// @return false for an unknown name
+/// ----------------------------------------------------------------------------
+bool io_backend(const char *name);
+
+/// ----------------------------------------------------------------------------
+/// @brief io_backend_name -- the backend in use, "posix" or "uring"
+/// ----------------------------------------------------------------------------
+const char *io_backend_name(void);
+
 /// ----------------------------------------------------------------------------
 /// @brief io_open_read
 /// 
@@ -67,6 +90,29 @@ int io_getc(int fd);
 /// ----------------------------------------------------------------------------
 int io_getc_timeout(int fd, int timeout_ms, unsigned char *c);
 
+/// ----------------------------------------------------------------------------
+/// @brief io_write_all -- the whole buffer, a short write is continued
+///
+/// @return false on error
+/// ----------------------------------------------------------------------------
+bool io_write_all(int fd, const void *buf, int size);
+
+/// ----------------------------------------------------------------------------
+/// @brief io_write_batch -- io_write_all() of n buffers in order, by a single
+/// submission with the uring backend
+///
+/// @return false on error
+/// ----------------------------------------------------------------------------
+bool io_write_batch(int fd, const struct iovec *iov, int n);
+
+/// ----------------------------------------------------------------------------
+/// @brief io_register -- buffers io_write_batch() of the calling thread writes
+/// from many times (registered buffers of io_uring), nothing with posix
+///
+/// @return false if they could not be registered, they are written anyway
+/// ----------------------------------------------------------------------------
+bool io_register(const struct iovec *iov, int n);
+
 #endif
 
 /* end of prg_io_nonblock.h */
@@ -0,0 +1,362 @@
+/*
+ * Filename: render.c
+ * Date:     2026/10/19
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include "affinity.h"
+#include "histo.h"
+#include "render.h"
+#include "ring.h"
+#include "trace.h"
+
+typedef enum {
+   JOB_COLOUR,  // rows of iters into img
+   JOB_FILL,    // rows of img by one colour
+   JOB_FENCE,   // wait for the present of the frame
+   JOB_SYNC,    // everything before is done, see render_sync()
+   JOB_QUIT,
+} job_kind;
+
+typedef struct {
+   job_kind kind;
+   int x0;
+   int y0;
+   int w;
+   int h;
+   int n;
+   uint8_t rgb[3];
+   uint64_t fence;
+} render_job;
+
+typedef struct { // header of a slot of the present ring, the argument follows
+   bool quit;
+   uint64_t fence;
+} present_req;
+
+typedef struct {
+   render *r;
+   ring_t jobs;
+   int event;        // new job or the fence released
+   uint64_t busy_ns; // (atomic)
+   long bands;       // (atomic)
+   pthread_t thread;
+} worker;
+
+struct render {
+   uint8_t *img;
+   const uint8_t *iters;
+   int w;
+   int h;
+   int arg_size;
+   render_present_fnc present;
+   void *ctx;
+   int workers;
+   worker worker[RENDER_MAX_WORKERS];
+   ring_t presents;
+   int event;          // the present thread: a frame queued or the last worker at its fence
+   int arrived;        // workers waiting at the fence (atomic)
+   uint64_t released;  // the last presented fence (atomic)
+   uint64_t fences;    // fences queued, the output thread only
+   uint64_t busy_ns;   // of the present thread (atomic)
+   int sync_event;     // render_sync(): the last worker at its JOB_SYNC
+   int synced;         // workers past their JOB_SYNC (atomic)
+   long presented;     // (atomic)
+   uint64_t t0;
+   long colour_pushes; // queue samples, the output thread only
+   long colour_depth;
+   int colour_max;
+   long colour_stalls;
+   long present_pushes;
+   long present_depth;
+   int present_max;
+   long present_stalls;
+   pthread_t thread;
+   bool started;
+};
+
+static void* colour_worker(void *d);
+static void* present_thread(void *d);
+
+// - function -----------------------------------------------------------------
+// colour of the iteration count, black for the points that never escape
+static inline void colorize(uint8_t iter, int n, uint8_t *px)
+{
+   double t = (double)iter / n; // t is in [0, 1]
+   if (t == 1) {
+      px[0] = px[1] = px[2] = 0;
+   } else {
+      px[0] = (uint8_t)(9 * (1 - t) * t * t * t * 255); // red component
+      px[1] = (uint8_t)(15 * (1 - t) * (1 - t) * t * t * 255); // green component
+      px[2] = (uint8_t)(8.5 * (1 - t) * (1 - t) * (1 - t) * t * 255); // blue component
+   }
+}
+
+// - function -----------------------------------------------------------------
+// the next slot of a ring, the depth the producer found is sampled
+static uint8_t *reserve(ring_t *ring, long *pushes, long *depth, int *max, long *stalls)
+{
+   const int d = (int)(ring->head - __atomic_load_n(&ring->tail, __ATOMIC_RELAXED));
+   *pushes += 1;
+   *depth += d;
+   *max = d > *max ? d : *max;
+   *stalls += d == RING_SLOTS;
+   return ring_reserve(ring);
+}
+
+// - function -----------------------------------------------------------------
+static void push_job(render *r, int i, const render_job *job)
+{
+   worker *w = &r->worker[i];
+   uint8_t *slot = reserve(&w->jobs, &r->colour_pushes, &r->colour_depth, &r->colour_max, &r->colour_stalls);
+   memcpy(slot, job, sizeof(render_job));
+   ring_commit(&w->jobs, sizeof(render_job));
+}
+
+// - function -----------------------------------------------------------------
+// the rows of the job in bands, one band per worker
+static void split_rows(render *r, render_job job)
+{
+   const int y0 = job.y0;
+   const int h = job.h;
+   const int band = (h + r->workers - 1) / r->workers;
+   for (int i = 0; i < r->workers && i * band < h; ++i) {
+      job.y0 = y0 + i * band;
+      job.h = h - i * band < band ? h - i * band : band;
+      push_job(r, i, &job);
+   }
+}
+
+// - function -----------------------------------------------------------------
+render *render_create(uint8_t *img, const uint8_t *iters, int w, int h, int workers, int arg_size, render_present_fnc present, void *ctx)
+{
+   if (workers <= 0) { // half the compute cpus of the placement, if any
+      workers = (affinity_workers() > 0 ? affinity_workers() : sysconf(_SC_NPROCESSORS_ONLN)) / 2;
+   }
+   workers = workers < 1 ? 1 : (workers > RENDER_MAX_WORKERS ? RENDER_MAX_WORKERS : workers);
+   render *r = calloc(1, sizeof(render));
+   if (r == NULL) {
+      return NULL;
+   }
+   *r = (render){ .img = img, .iters = iters, .w = w, .h = h, .arg_size = arg_size, .present = present, .ctx = ctx, .t0 = histo_now(), .presents = { .space = -1 }, .sync_event = -1 };
+   // the slots aligned for the argument
+   bool ok = (r->event = ring_event()) >= 0 && (r->sync_event = ring_event()) >= 0 && ring_init(&r->presents, (sizeof(present_req) + arg_size + 15) & ~15, r->event);
+   for (int i = 0; ok && i < workers; ++i) {
+      worker *wk = &r->worker[i];
+      wk->r = r;
+      ok = (wk->event = ring_event()) >= 0 && ring_init(&wk->jobs, sizeof(render_job), wk->event);
+      if (ok && pthread_create(&wk->thread, NULL, colour_worker, wk) != 0) {
+         ring_destroy(&wk->jobs);
+         ok = false;
+      }
+      if (!ok && wk->event >= 0) {
+         close(wk->event);
+      }
+      r->workers += ok;
+   }
+   r->started = ok && pthread_create(&r->thread, NULL, present_thread, r) == 0;
+   if (!r->started) {
+      fprintf(stderr, "\033[1;31mERROR\033[0m: Unable to start the colour and present threads\r\n");
+      render_free(r, NULL);
+      return NULL;
+   }
+   return r;
+}
+
+// - function -----------------------------------------------------------------
+void render_colour(render *r, int x0, int y0, int w, int h, int n)
+{
+   split_rows(r, (render_job){ .kind = JOB_COLOUR, .x0 = x0, .y0 = y0, .w = w, .h = h, .n = n });
+}
+
+// - function -----------------------------------------------------------------
+void render_fill(render *r, uint8_t red, uint8_t green, uint8_t blue)
+{
+   split_rows(r, (render_job){ .kind = JOB_FILL, .x0 = 0, .y0 = 0, .w = r->w, .h = r->h, .rgb = { red, green, blue } });
+}
+
+// - function -----------------------------------------------------------------
+void render_present(render *r, const void *arg)
+{
+   const render_job fence = { .kind = JOB_FENCE, .fence = ++r->fences };
+   for (int i = 0; i < r->workers; ++i) { // the fence first, so the workers may reach it
+      push_job(r, i, &fence);
+   }
+   uint8_t *slot = reserve(&r->presents, &r->present_pushes, &r->present_depth, &r->present_max, &r->present_stalls);
+   *(present_req*)slot = (present_req){ .fence = fence.fence };
+   memcpy(slot + sizeof(present_req), arg, r->arg_size);
+   ring_commit(&r->presents, sizeof(present_req) + r->arg_size);
+}
+
+// - function -----------------------------------------------------------------
+void render_sync(render *r)
+{
+   const render_job sync = { .kind = JOB_SYNC };
+   __atomic_store_n(&r->synced, 0, __ATOMIC_SEQ_CST);
+   for (int i = 0; i < r->workers; ++i) {
+      push_job(r, i, &sync);
+   }
+   while (__atomic_load_n(&r->synced, __ATOMIC_SEQ_CST) < r->workers) {
+      ring_wait(r->sync_event);
+   }
+}
+
+// - function -----------------------------------------------------------------
+void render_get_stats(render *r, render_stats *st)
+{
+   const double wall = (histo_now() - r->t0) * 1e-9;
+   uint64_t busy = 0;
+   *st = (render_stats){ .wall_s = wall, .workers = r->workers };
+   for (int i = 0; i < r->workers; ++i) {
+      busy += __atomic_load_n(&r->worker[i].busy_ns, __ATOMIC_RELAXED);
+      st->bands += __atomic_load_n(&r->worker[i].bands, __ATOMIC_RELAXED);
+   }
+   if (wall > 0 && r->workers > 0) {
+      st->colour_busy = busy * 1e-9 / wall / r->workers;
+      st->present_busy = __atomic_load_n(&r->busy_ns, __ATOMIC_RELAXED) * 1e-9 / wall;
+   }
+   st->colour_queue = r->colour_pushes ? (double)r->colour_depth / r->colour_pushes : 0;
+   st->colour_queue_max = r->colour_max;
+   st->colour_stalls = r->colour_stalls;
+   st->present_queue = r->present_pushes ? (double)r->present_depth / r->present_pushes : 0;
+   st->present_queue_max = r->present_max;
+   st->present_stalls = r->present_stalls;
+   st->presents = __atomic_load_n(&r->presented, __ATOMIC_RELAXED);
+}
+
+// - function -----------------------------------------------------------------
+void render_free(render *r, render_stats *st)
+{
+   if (r == NULL) {
+      return;
+   }
+   const render_job quit = { .kind = JOB_QUIT };
+   for (int i = 0; i < r->workers; ++i) { // behind everything queued
+      push_job(r, i, &quit);
+   }
+   if (r->started) {
+      *(present_req*)ring_reserve(&r->presents) = (present_req){ .quit = true };
+      ring_commit(&r->presents, sizeof(present_req));
+      pthread_join(r->thread, NULL);
+   }
+   for (int i = 0; i < r->workers; ++i) {
+      pthread_join(r->worker[i].thread, NULL);
+   }
+   if (st) {
+      render_get_stats(r, st);
+   }
+   for (int i = 0; i < r->workers; ++i) {
+      ring_destroy(&r->worker[i].jobs);
+      close(r->worker[i].event);
+   }
+   ring_destroy(&r->presents);
+   if (r->event >= 0) {
+      close(r->event);
+   }
+   if (r->sync_event >= 0) {
+      close(r->sync_event);
+   }
+   free(r);
+}
+
+// - function -----------------------------------------------------------------
+static void* colour_worker(void *d)
+{
+   worker *w = (worker*)d;
+   render *r = w->r;
+   trace_thread("colour");
+   affinity_pin(AFFINITY_COLOUR, 0, "colour");
+   while (true) {
+      int len;
+      const render_job *job = (const render_job*)ring_peek(&w->jobs, &len);
+      if (job == NULL) {
+         ring_wait(w->event);
+         continue;
+      }
+      if (job->kind == JOB_QUIT) {
+         ring_release(&w->jobs);
+         break;
+      }
+      if (job->kind == JOB_SYNC) {
+         ring_release(&w->jobs);
+         if (__atomic_add_fetch(&r->synced, 1, __ATOMIC_SEQ_CST) == r->workers) {
+            ring_wake(r->sync_event);
+         }
+         continue;
+      }
+      if (job->kind == JOB_FENCE) {
+         const uint64_t fence = job->fence;
+         ring_release(&w->jobs);
+         if (__atomic_add_fetch(&r->arrived, 1, __ATOMIC_SEQ_CST) == r->workers) {
+            ring_wake(r->event);
+         }
+         while (__atomic_load_n(&r->released, __ATOMIC_SEQ_CST) < fence) {
+            ring_wait(w->event); // a job queued meanwhile wakes it as well
+         }
+         continue;
+      }
+      const uint64_t s0 = TRACE_BEGIN();
+      const uint64_t t0 = histo_now();
+      for (int y = job->y0; y < job->y0 + job->h; ++y) {
+         uint8_t *px = r->img + (y * r->w + job->x0) * 3;
+         const uint8_t *it = r->iters + y * r->w + job->x0;
+         for (int x = 0; x < job->w; ++x, px += 3) {
+            if (job->kind == JOB_COLOUR) {
+               colorize(it[x], job->n, px);
+            } else {
+               memcpy(px, job->rgb, 3);
+            }
+         }
+      }
+      const uint64_t t1 = histo_now();
+      HISTO_ADD(STAGE_COLOR, t1 - t0);
+      TRACE_END("colour", s0, job->y0);
+      __atomic_fetch_add(&w->busy_ns, t1 - t0, __ATOMIC_RELAXED);
+      __atomic_fetch_add(&w->bands, 1, __ATOMIC_RELAXED);
+      ring_release(&w->jobs);
+   }
+   return NULL;
+}
+
+// - function -----------------------------------------------------------------
+static void* present_thread(void *d)
+{
+   render *r = (render*)d;
+   trace_thread("present");
+   affinity_pin(AFFINITY_IO, 0, "present");
+   while (true) {
+      int len;
+      const uint8_t *slot = ring_peek(&r->presents, &len);
+      if (slot == NULL) {
+         ring_wait(r->event);
+         continue;
+      }
+      const present_req req = *(const present_req*)slot;
+      if (req.quit) {
+         ring_release(&r->presents);
+         break;
+      }
+      while (__atomic_load_n(&r->arrived, __ATOMIC_SEQ_CST) < r->workers) {
+         ring_wait(r->event); // the image is not whole yet
+      }
+      const uint64_t t0 = histo_now();
+      r->present(r->ctx, r->img, slot + sizeof(present_req));
+      __atomic_fetch_add(&r->busy_ns, histo_now() - t0, __ATOMIC_RELAXED);
+      __atomic_fetch_add(&r->presented, 1, __ATOMIC_RELAXED);
+      ring_release(&r->presents);
+      __atomic_store_n(&r->arrived, 0, __ATOMIC_SEQ_CST); // before any worker may go on
+      __atomic_store_n(&r->released, req.fence, __ATOMIC_SEQ_CST);
+      for (int i = 0; i < r->workers; ++i) {
+         ring_wake(r->worker[i].event);
+      }
+   }
+   return NULL;
+}
+
+/* end of render.c */
@@ -0,0 +1,98 @@
+/*
+ * Filename: render.h
+ * Date:     2026/10/19
+ *
+ * Colourise and present stages of the receive path of prgsem-main. The
+ * output thread only decodes the messages into the iteration grid and queues
+ * the chunks to colour and the frames to present; a small pool of colour
+ * workers splits every chunk by rows and a present thread hands the image to
+ * the window and the video sink. The stages are connected by the lock-free
+ * rings of ring.c, a full ring holds its producer back. A present waits for
+ * the chunks queued before it and the workers do not touch the image until
+ * it is done, so every presented frame is whole and in order.
+ */
+
+#ifndef __RENDER_H__
+#define __RENDER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define RENDER_MAX_WORKERS 4
+
+typedef struct render render;
+
+// called by the present thread with the finished image and the argument of
+// render_present()
+typedef void (*render_present_fnc)(void *ctx, const uint8_t *img, const void *arg);
+
+typedef struct { // occupancy of the stages since render_create()
+   double wall_s;
+   int workers;
+   double colour_busy;    // mean share of the wall time a colour worker worked
+   double present_busy;   // share of the wall time the present thread worked
+   double colour_queue;   // mean jobs already waiting in the ring of a worker a job is queued to
+   int colour_queue_max;
+   long colour_stalls;    // jobs queued to a full ring, the output thread waited
+   double present_queue;  // the same for the ring of the present thread
+   int present_queue_max;
+   long present_stalls;
+   long bands;            // row bands coloured
+   long presents;
+} render_stats;
+
+/// ----------------------------------------------------------------------------
+/// @brief render_create -- start the colour workers and the present thread
+///
+/// @param img      -- w * h rgb pixels, written by the workers only from now on
+/// @param iters    -- w * h iteration counts, a chunk must not change until
+///                    its render_colour() is done, see render_sync()
+/// @param workers  -- colour workers, 0 for half the compute cpus of the
+///                    placement (see affinity_workers()) or of the online
+///                    cpus; at most RENDER_MAX_WORKERS
+/// @param arg_size -- bytes of the argument of render_present()
+/// @param present  -- called by the present thread for every render_present()
+///
+/// @return handle or NULL on error
+/// ----------------------------------------------------------------------------
+render *render_create(uint8_t *img, const uint8_t *iters, int w, int h, int workers, int arg_size, render_present_fnc present, void *ctx);
+
+/// ----------------------------------------------------------------------------
+/// @brief render_colour -- colourise a rectangle of iters into img, n is the
+/// iteration limit of the frame; the rows are split among the workers
+/// ----------------------------------------------------------------------------
+void render_colour(render *r, int x0, int y0, int w, int h, int n);
+
+/// ----------------------------------------------------------------------------
+/// @brief render_fill -- fill the whole image by one colour
+/// ----------------------------------------------------------------------------
+void render_fill(render *r, uint8_t red, uint8_t green, uint8_t blue);
+
+/// ----------------------------------------------------------------------------
+/// @brief render_present -- present the image once everything queued before is
+/// coloured; arg (arg_size bytes) is copied
+/// ----------------------------------------------------------------------------
+void render_present(render *r, const void *arg);
+
+/// ----------------------------------------------------------------------------
+/// @brief render_sync -- wait until every render_colour() and render_fill()
+/// queued before is done, iters may change afterwards (e.g., the next frame)
+/// ----------------------------------------------------------------------------
+void render_sync(render *r);
+
+/// ----------------------------------------------------------------------------
+/// @brief render_get_stats -- occupancy of the stages, may be called while
+/// they work
+/// ----------------------------------------------------------------------------
+void render_get_stats(render *r, render_stats *st);
+
+/// ----------------------------------------------------------------------------
+/// @brief render_free -- finish everything queued and stop the threads
+///
+/// @param st -- the final render_get_stats(), NULL if not needed
+/// ----------------------------------------------------------------------------
+void render_free(render *r, render_stats *st);
+
+#endif
+
+/* end of render.h */
@@ -0,0 +1,154 @@
+/*
+ * Filename: ring.c
+ * Date:     2026/10/19
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <sys/eventfd.h>
+
+#include "ring.h"
+
+// head and tail are sequentially consistent: a side publishes its index and
+// then reads the other one, so either it sees the progress of the other side
+// or the other side sees its own and wakes it (no lost wake-up)
+
+// - function -----------------------------------------------------------------
+static bool init(ring_t *r, int size, int ready, long align)
+{
+   *r = (ring_t){ .size = size, .ready = ready, .space = -1 };
+   void *slots = NULL;
+   if (align > 0) {
+      r->size = size = (size + align - 1) / align * align;
+      if (posix_memalign(&slots, align, (size_t)RING_SLOTS * size) != 0) {
+         slots = NULL;
+      }
+   } else {
+      slots = malloc((size_t)RING_SLOTS * size);
+   }
+   r->slots = slots;
+   r->space = eventfd(0, EFD_CLOEXEC);
+   if (r->slots == NULL || r->space < 0) {
+      ring_destroy(r);
+      return false;
+   }
+   return true;
+}
+
+// - function -----------------------------------------------------------------
+bool ring_init(ring_t *r, int size, int ready)
+{
+   return init(r, size, ready, 0);
+}
+
+// - function -----------------------------------------------------------------
+bool ring_init_pages(ring_t *r, int size, int ready)
+{
+   return init(r, size, ready, sysconf(_SC_PAGESIZE));
+}
+
+// - function -----------------------------------------------------------------
+void ring_destroy(ring_t *r)
+{
+   free(r->slots);
+   r->slots = NULL;
+   if (r->space >= 0) {
+      close(r->space);
+   }
+   r->space = -1;
+}
+
+// - function -----------------------------------------------------------------
+uint8_t *ring_reserve(ring_t *r)
+{
+   const uint64_t h = r->head; // written by this thread only
+   while (h - __atomic_load_n(&r->tail, __ATOMIC_SEQ_CST) == RING_SLOTS) {
+      ring_wait(r->space);
+   }
+   return r->slots + (h % RING_SLOTS) * r->size;
+}
+
+// - function -----------------------------------------------------------------
+void ring_commit(ring_t *r, int len)
+{
+   const uint64_t h = r->head;
+   r->len[h % RING_SLOTS] = len;
+   __atomic_store_n(&r->head, h + 1, __ATOMIC_SEQ_CST);
+   if (__atomic_load_n(&r->tail, __ATOMIC_SEQ_CST) == h) { // the consumer may sleep on the empty ring
+      ring_wake(r->ready);
+   }
+}
+
+// - function -----------------------------------------------------------------
+const uint8_t *ring_peek(ring_t *r, int *len)
+{
+   const uint64_t t = r->tail; // written by this thread only
+   if (__atomic_load_n(&r->head, __ATOMIC_SEQ_CST) == t) {
+      return NULL;
+   }
+   *len = r->len[t % RING_SLOTS];
+   return r->slots + (t % RING_SLOTS) * r->size;
+}
+
+// - function -----------------------------------------------------------------
+const uint8_t *ring_take(ring_t *r, int *len)
+{
+   const uint64_t t = r->taken;
+   if (__atomic_load_n(&r->head, __ATOMIC_SEQ_CST) == t) {
+      return NULL;
+   }
+   r->taken = t + 1;
+   *len = r->len[t % RING_SLOTS];
+   return r->slots + (t % RING_SLOTS) * r->size;
+}
+
+// - function -----------------------------------------------------------------
+void ring_release(ring_t *r)
+{
+   const uint64_t t = r->tail;
+   if (r->taken < t + 1) { // released by ring_peek()
+      r->taken = t + 1;
+   }
+   __atomic_store_n(&r->tail, t + 1, __ATOMIC_SEQ_CST);
+   if (__atomic_load_n(&r->head, __ATOMIC_SEQ_CST) - t == RING_SLOTS) { // the producer may sleep on the full ring
+      ring_wake(r->space);
+   }
+}
+
+// - function -----------------------------------------------------------------
+int ring_event(void)
+{
+   return eventfd(0, EFD_CLOEXEC);
+}
+
+// - function -----------------------------------------------------------------
+void ring_wait(int event)
+{
+   uint64_t v;
+   while (read(event, &v, sizeof(v)) < 0 && errno == EINTR) { }
+}
+
+// - function -----------------------------------------------------------------
+bool ring_wait_timeout(int event, int ms)
+{
+   struct pollfd pfd = { .fd = event, .events = POLLIN };
+   int n;
+   while ((n = poll(&pfd, 1, ms)) < 0 && errno == EINTR) { }
+   if (n <= 0) {
+      return false;
+   }
+   ring_wait(event);
+   return true;
+}
+
+// - function -----------------------------------------------------------------
+void ring_wake(int event)
+{
+   const uint64_t v = 1;
+   while (write(event, &v, sizeof(v)) < 0 && errno == EINTR) { }
+}
+
+/* end of ring.c */
@@ -0,0 +1,108 @@
+/*
+ * Filename: ring.h
+ * Date:     2026/10/19
+ *
+ * Lock-free single producer, single consumer ring of batches from the
+ * threads of ./module to its pipe writer. A batch (frames of one row, a
+ * packed chunk, a reply) is encoded straight into a slot of the ring, so the
+ * producers never take a lock nor call write(). The sleeping side is woken by
+ * an eventfd only when the ring turns from empty or from full; one eventfd of
+ * the consumer may be shared by several rings. A consumer that hands the
+ * slots on by reference (vmsplice()) takes several batches before it releases
+ * the oldest one.
+ */
+
+#ifndef __RING_H__
+#define __RING_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define RING_SLOTS 8 // power of two
+
+typedef struct {
+   uint8_t *slots;        // RING_SLOTS buffers of size bytes
+   int size;
+   int len[RING_SLOTS];   // bytes of the committed batches
+   uint64_t head;         // batches committed, written by the producer (atomic)
+   uint64_t tail;         // batches released, written by the consumer (atomic)
+   uint64_t taken;        // batches handed out by ring_take(), consumer only
+   int space;             // eventfd of the producer, a slot of the full ring was released
+   int ready;             // eventfd of the consumer, a batch came into the empty ring
+} ring_t;
+
+/// ----------------------------------------------------------------------------
+/// @brief ring_init -- RING_SLOTS slots of size bytes
+///
+/// @param ready -- eventfd of the consumer, see ring_event()
+/// @return false on error
+/// ----------------------------------------------------------------------------
+bool ring_init(ring_t *r, int size, int ready);
+
+/// ----------------------------------------------------------------------------
+/// @brief ring_init_pages -- ring_init() with every slot page aligned and a
+/// whole number of pages, so a batch may be given to vmsplice()
+/// ----------------------------------------------------------------------------
+bool ring_init_pages(ring_t *r, int size, int ready);
+
+/// ----------------------------------------------------------------------------
+/// @brief ring_destroy -- free the slots, the ready eventfd is left open
+/// ----------------------------------------------------------------------------
+void ring_destroy(ring_t *r);
+
+/// ----------------------------------------------------------------------------
+/// @brief ring_reserve -- producer: the next free slot of r->size bytes, the
+/// caller sleeps while the ring is full
+/// ----------------------------------------------------------------------------
+uint8_t *ring_reserve(ring_t *r);
+
+/// ----------------------------------------------------------------------------
+/// @brief ring_commit -- producer: hand len bytes of the reserved slot over to
+/// the consumer
+/// ----------------------------------------------------------------------------
+void ring_commit(ring_t *r, int len);
+
+/// ----------------------------------------------------------------------------
+/// @brief ring_peek -- consumer: the oldest committed batch, NULL if none
+/// ----------------------------------------------------------------------------
+const uint8_t *ring_peek(ring_t *r, int *len);
+
+/// ----------------------------------------------------------------------------
+/// @brief ring_take -- consumer: the oldest committed batch not taken yet, NULL
+/// if none; it stays in its slot until ring_release(), the batches are
+/// released in the order they were taken
+/// ----------------------------------------------------------------------------
+const uint8_t *ring_take(ring_t *r, int *len);
+
+/// ----------------------------------------------------------------------------
+/// @brief ring_release -- consumer: give the slot of ring_peek() or the oldest
+/// slot of ring_take() back
+/// ----------------------------------------------------------------------------
+void ring_release(ring_t *r);
+
+/// ----------------------------------------------------------------------------
+/// @brief ring_event -- new eventfd of a consumer, -1 on error
+/// ----------------------------------------------------------------------------
+int ring_event(void);
+
+/// ----------------------------------------------------------------------------
+/// @brief ring_wait -- consumer: sleep until a ring of the eventfd turns
+/// non-empty or ring_wake() is called; check all the rings before
+/// ----------------------------------------------------------------------------
+void ring_wait(int event);
+
+/// ----------------------------------------------------------------------------
+/// @brief ring_wait_timeout -- ring_wait() for at most ms milliseconds
+///
+/// @return false on the timeout
+/// ----------------------------------------------------------------------------
+bool ring_wait_timeout(int event, int ms);
+
+/// ----------------------------------------------------------------------------
+/// @brief ring_wake -- wake the thread in ring_wait(), e.g., to quit
+/// ----------------------------------------------------------------------------
+void ring_wake(int event);
+
+#endif
+
+/* end of ring.h */
@@ -0,0 +1,30 @@
+/*
+ * Filename: scenes.c
+ * Date:     2026/10/19
+ */
+
+#include <string.h>
+
+#include "scenes.h"
+
+const scene_t scenes[] = {
+   { "default",  -0.4,   0.6,   -1.6,  1.1,  0.005,  (double)-11/2400, 60 },
+   { "interior", -0.123, 0.745, -0.48, 0.36, 0.0015, -0.0015,          255 }, // ~75% of pixels never escape
+   { "zoom",     -0.8,   0.156, -0.32, 0.24, 0.001,  -0.001,           255 }, // boundary filaments everywhere
+   { "deep",     -0.123, 0.745, -0.43513817456876164 - 320e-15, 0.1 + 240e-15, 1e-15, -1e-15, 255 }, // below double precision, the perturbation kernel
+};
+
+const int scenes_count = sizeof(scenes) / sizeof(scenes[0]);
+
+// - function -----------------------------------------------------------------
+const scene_t *scene_find(const char *name)
+{
+   for (int i = 0; i < scenes_count; ++i) {
+      if (strcmp(name, scenes[i].name) == 0) {
+         return &scenes[i];
+      }
+   }
+   return NULL;
+}
+
+/* end of scenes.c */
@@ -0,0 +1,36 @@
+/*
+ * Filename: scenes.h
+ * Date:     2026/10/19
+ *
+ * Fixed scenes shared by prgsem-main (--scene) and the kernel benchmark.
+ */
+
+#ifndef __SCENES_H__
+#define __SCENES_H__
+
+#include <stdint.h>
+
+typedef struct { // fixed parameters of one rendered frame
+   const char *name;
+   double c_re;  // re (x) part of the c constant
+   double c_im;  // im (y) part of the c constant
+   double re;    // upper left corner (real)
+   double im;    // upper left corner (imaginary)
+   double d_re;  // step per pixel (real)
+   double d_im;  // step per pixel (imaginary)
+   uint8_t n;    // number of iterations
+} scene_t;
+
+extern const scene_t scenes[];
+extern const int scenes_count;
+
+/// ----------------------------------------------------------------------------
+/// @brief scene_find
+///
+/// @return scene of the given name or NULL
+/// ----------------------------------------------------------------------------
+const scene_t *scene_find(const char *name);
+
+#endif
+
+/* end of scenes.h */
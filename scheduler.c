@@ -0,0 +1,257 @@
+/*
+ * Filename: scheduler.c
+ * Date:     2026/10/19
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <pthread.h>
+
+#include "scheduler.h"
+
+typedef struct {
+   uint8_t owner;     // side of the kept result, SCHED_NONE until done
+   uint8_t inflight;  // bit per side computing the chunk
+   double started[SCHED_SIDES];
+   double cost;       // predicted, see sched_set_cost()
+   double work;       // measured of the kept result
+} sched_chunk;
+
+struct scheduler {
+   pthread_mutex_t mtx;
+   int chunks;
+   sched_chunk *chunk;
+   int done;
+   int kept[SCHED_SIDES];
+   int lost[SCHED_SIDES];
+   int finished[SCHED_SIDES];   // all results, kept or lost
+   double busy[SCHED_SIDES];    // time of all results
+   int duplicated;
+   bool costed;                 // sched_set_cost() has been called
+};
+
+// - function -----------------------------------------------------------------
+static double sched_time(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// - function -----------------------------------------------------------------
+static double chunk_time(scheduler *s, sched_side side)
+{
+   return s->finished[side] ? s->busy[side] / s->finished[side] : 0;
+}
+
+// - function -----------------------------------------------------------------
+scheduler *sched_create(int chunks)
+{
+   scheduler *s = calloc(1, sizeof(scheduler));
+   if (s == NULL) {
+      return NULL;
+   }
+   s->chunk = calloc(chunks, sizeof(sched_chunk));
+   if (s->chunk == NULL) {
+      free(s);
+      return NULL;
+   }
+   s->chunks = chunks;
+   for (int i = 0; i < chunks; ++i) {
+      s->chunk[i].owner = SCHED_NONE;
+   }
+   pthread_mutex_init(&s->mtx, NULL);
+   return s;
+}
+
+// - function -----------------------------------------------------------------
+void sched_free(scheduler *s)
+{
+   if (s == NULL) {
+      return;
+   }
+   pthread_mutex_destroy(&s->mtx);
+   free(s->chunk);
+   free(s);
+}
+
+// - function -----------------------------------------------------------------
+int sched_take(scheduler *s, sched_side side)
+{
+   const sched_side other = side == SCHED_LOCAL ? SCHED_REMOTE : SCHED_LOCAL;
+   const double now = sched_time();
+   int cid = -1;
+   pthread_mutex_lock(&s->mtx);
+   for (int i = 0; i < s->chunks && (cid < 0 || s->costed); ++i) {
+      if (s->chunk[i].owner == SCHED_NONE && s->chunk[i].inflight == 0 && (cid < 0 || s->chunk[i].cost > s->chunk[cid].cost)) {
+         cid = i;
+      }
+   }
+   if (cid < 0) {
+      // tail of the frame - duplicate the chunk the other side is expected to
+      // finish last, if this side would be sooner (unknown times are optimistic)
+      const double mine = now + chunk_time(s, side);
+      double latest = mine;
+      for (int i = 0; i < s->chunks; ++i) {
+         const sched_chunk *c = &s->chunk[i];
+         if (c->owner == SCHED_NONE && c->inflight == (1 << other)) {
+            const double t = c->started[other] + (chunk_time(s, other) > 0 ? chunk_time(s, other) : 1e9);
+            if (t > latest) {
+               latest = t;
+               cid = i;
+            }
+         }
+      }
+      s->duplicated += cid >= 0;
+   }
+   if (cid >= 0) {
+      s->chunk[cid].inflight |= 1 << side;
+      s->chunk[cid].started[side] = now;
+   }
+   pthread_mutex_unlock(&s->mtx);
+   return cid;
+}
+
+// - function -----------------------------------------------------------------
+bool sched_finish(scheduler *s, int cid, sched_side side)
+{
+   const double now = sched_time();
+   pthread_mutex_lock(&s->mtx);
+   sched_chunk *c = &s->chunk[cid];
+   c->inflight &= ~(1 << side);
+   s->finished[side] += 1;
+   s->busy[side] += now - c->started[side];
+   const bool first = c->owner == SCHED_NONE;
+   if (first) {
+      c->owner = side;
+      c->work = now - c->started[side];
+      s->kept[side] += 1;
+      s->done += 1;
+   } else {
+      s->lost[side] += 1;
+   }
+   pthread_mutex_unlock(&s->mtx);
+   return first;
+}
+
+// - function -----------------------------------------------------------------
+void sched_release(scheduler *s, int cid, sched_side side)
+{
+   pthread_mutex_lock(&s->mtx);
+   s->chunk[cid].inflight &= ~(1 << side);
+   pthread_mutex_unlock(&s->mtx);
+}
+
+// - function -----------------------------------------------------------------
+bool sched_is_done(scheduler *s, int cid)
+{
+   pthread_mutex_lock(&s->mtx);
+   bool ret = cid >= 0 && cid < s->chunks && s->chunk[cid].owner != SCHED_NONE;
+   pthread_mutex_unlock(&s->mtx);
+   return ret;
+}
+
+// - function -----------------------------------------------------------------
+bool sched_complete(scheduler *s)
+{
+   pthread_mutex_lock(&s->mtx);
+   bool ret = s->done == s->chunks;
+   pthread_mutex_unlock(&s->mtx);
+   return ret;
+}
+
+// - function -----------------------------------------------------------------
+void sched_set_cost(scheduler *s, const double *cost)
+{
+   pthread_mutex_lock(&s->mtx);
+   for (int i = 0; i < s->chunks; ++i) {
+      s->chunk[i].cost = cost[i];
+   }
+   s->costed = true;
+   pthread_mutex_unlock(&s->mtx);
+}
+
+// - function -----------------------------------------------------------------
+void sched_set_work(scheduler *s, int cid, double work_s)
+{
+   pthread_mutex_lock(&s->mtx);
+   s->chunk[cid].work = work_s;
+   pthread_mutex_unlock(&s->mtx);
+}
+
+// - function -----------------------------------------------------------------
+void sched_get_cost(scheduler *s, double *cost, double *work)
+{
+   pthread_mutex_lock(&s->mtx);
+   for (int i = 0; i < s->chunks; ++i) {
+      cost[i] = s->chunk[i].cost;
+      work[i] = s->chunk[i].owner != SCHED_NONE ? s->chunk[i].work : 0;
+   }
+   pthread_mutex_unlock(&s->mtx);
+}
+
+// - function -----------------------------------------------------------------
+// Pearson correlation of the predicted cost and the measured work of the kept
+// chunks, called with the mutex locked
+static double cost_corr(scheduler *s)
+{
+   double n = 0, sx = 0, sy = 0, sxx = 0, syy = 0, sxy = 0;
+   for (int i = 0; s->costed && i < s->chunks; ++i) {
+      const sched_chunk *c = &s->chunk[i];
+      if (c->owner != SCHED_NONE) {
+         n += 1;
+         sx += c->cost;
+         sy += c->work;
+         sxx += c->cost * c->cost;
+         syy += c->work * c->work;
+         sxy += c->cost * c->work;
+      }
+   }
+   const double vx = n * sxx - sx * sx;
+   const double vy = n * syy - sy * sy;
+   return vx > 0 && vy > 0 ? (n * sxy - sx * sy) / sqrt(vx * vy) : 0;
+}
+
+// - function -----------------------------------------------------------------
+void sched_get_stats(scheduler *s, sched_stats *st)
+{
+   pthread_mutex_lock(&s->mtx);
+   for (int i = 0; i < SCHED_SIDES; ++i) {
+      st->kept[i] = s->kept[i];
+      st->lost[i] = s->lost[i];
+      st->chunk_s[i] = chunk_time(s, i);
+   }
+   st->duplicated = s->duplicated;
+   st->cost_corr = cost_corr(s);
+   st->done = s->done;
+   st->chunks = s->chunks;
+   pthread_mutex_unlock(&s->mtx);
+}
+
+// - function -----------------------------------------------------------------
+void sched_print(scheduler *s, FILE *f, int n_re)
+{
+   static const char owner[] = { 'L', 'R', '.' };
+   static const char inflight[] = { '.', 'l', 'r', '*' };
+   sched_stats st;
+   sched_get_stats(s, &st);
+   pthread_mutex_lock(&s->mtx);
+   for (int i = 0; i < s->chunks; ++i) {
+      const sched_chunk *c = &s->chunk[i];
+      fputc(c->owner != SCHED_NONE ? owner[c->owner] : inflight[c->inflight], f);
+      fputs((i + 1) % n_re == 0 || i + 1 == s->chunks ? "\r\n" : " ", f);
+   }
+   pthread_mutex_unlock(&s->mtx);
+   fprintf(f, "local: %d kept, %d lost, %.3f ms/chunk; remote: %d kept, %d lost, %.3f ms/chunk; duplicated %d; done %d/%d\r\n",
+         st.kept[SCHED_LOCAL], st.lost[SCHED_LOCAL], st.chunk_s[SCHED_LOCAL] * 1e3,
+         st.kept[SCHED_REMOTE], st.lost[SCHED_REMOTE], st.chunk_s[SCHED_REMOTE] * 1e3,
+         st.duplicated, st.done, st.chunks);
+   if (s->costed) {
+      fprintf(f, "cost model: predicted vs measured work of the kept chunks r = %.3f\r\n", st.cost_corr);
+   }
+}
+
+/* end of scheduler.c */
@@ -0,0 +1,108 @@
+/*
+ * Filename: scheduler.h
+ * Date:     2026/10/19
+ *
+ * Chunk scheduler of one frame shared by the local workers and the remote
+ * module. Each side takes a chunk when it is idle; at the end of the frame a
+ * chunk still computed by the slower side is handed to the other one as well
+ * and the first result is kept. With a predicted cost of every chunk the most
+ * expensive pending chunk goes first (longest processing time first), so the
+ * cheap ones fill the gaps at the end of the frame.
+ */
+
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef enum {
+   SCHED_LOCAL,
+   SCHED_REMOTE,
+   SCHED_SIDES,
+   SCHED_NONE = SCHED_SIDES,
+} sched_side;
+
+typedef struct {
+   int kept[SCHED_SIDES];        // chunks whose result comes from the side
+   int lost[SCHED_SIDES];        // duplicated chunks finished second
+   double chunk_s[SCHED_SIDES];  // measured mean time per chunk, 0 if unknown
+   int duplicated;               // chunks given to both sides
+   double cost_corr;             // correlation of the predicted cost and the measured
+                                 // work of the kept chunks, 0 without a prediction
+   int done;                     // chunks with a result
+   int chunks;
+} sched_stats;
+
+typedef struct scheduler scheduler;
+
+/// ----------------------------------------------------------------------------
+/// @brief sched_create -- scheduler of chunks 0 .. chunks - 1, NULL on error
+/// ----------------------------------------------------------------------------
+scheduler *sched_create(int chunks);
+
+void sched_free(scheduler *s);
+
+/// ----------------------------------------------------------------------------
+/// @brief sched_take -- next chunk for an idle side
+///
+/// @return the first pending chunk, otherwise a chunk in flight on the other
+///         side that this side is expected to finish sooner, -1 if none
+/// ----------------------------------------------------------------------------
+int sched_take(scheduler *s, sched_side side);
+
+/// ----------------------------------------------------------------------------
+/// @brief sched_finish -- the side finished the chunk
+///
+/// @return true if it is the first result of the chunk (keep it), false if the
+///         other side has been faster (discard it)
+/// ----------------------------------------------------------------------------
+bool sched_finish(scheduler *s, int cid, sched_side side);
+
+/// ----------------------------------------------------------------------------
+/// @brief sched_release -- the side gives the chunk up without a result (abort)
+/// ----------------------------------------------------------------------------
+void sched_release(scheduler *s, int cid, sched_side side);
+
+/// ----------------------------------------------------------------------------
+/// @brief sched_is_done -- the chunk has a result already
+/// ----------------------------------------------------------------------------
+bool sched_is_done(scheduler *s, int cid);
+
+/// ----------------------------------------------------------------------------
+/// @brief sched_complete -- every chunk of the frame has a result
+/// ----------------------------------------------------------------------------
+bool sched_complete(scheduler *s);
+
+/// ----------------------------------------------------------------------------
+/// @brief sched_set_cost -- predicted cost of every chunk, any unit (only the
+/// order and the ratios matter); sched_take() then hands out the most
+/// expensive pending chunk instead of the lowest cid
+/// ----------------------------------------------------------------------------
+void sched_set_cost(scheduler *s, const double *cost);
+
+/// ----------------------------------------------------------------------------
+/// @brief sched_set_work -- measured work of a kept chunk in s; the time from
+/// sched_take() to sched_finish() of the side that kept it by default
+/// ----------------------------------------------------------------------------
+void sched_set_work(scheduler *s, int cid, double work_s);
+
+/// ----------------------------------------------------------------------------
+/// @brief sched_get_cost -- the predicted cost and the measured work (0 until
+/// kept) of every chunk, to check the cost model
+/// ----------------------------------------------------------------------------
+void sched_get_cost(scheduler *s, double *cost, double *work);
+
+void sched_get_stats(scheduler *s, sched_stats *st);
+
+/// ----------------------------------------------------------------------------
+/// @brief sched_print -- chunk ownership map (n_re chunks per row) and stats
+///
+/// L/R result kept from the local/remote side, l/r in flight, * in flight on
+/// both sides, . pending
+/// ----------------------------------------------------------------------------
+void sched_print(scheduler *s, FILE *f, int n_re);
+
+#endif
+
+/* end of scheduler.h */
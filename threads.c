@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 
+#include <errno.h>
 #include <fcntl.h>
 #include <sys/types.h>
 #include <time.h>
@@ -13,9 +14,22 @@
 #include <termios.h>
 #include <unistd.h> // for STDIN_FILENO
 
+#include <getopt.h>
+#include <poll.h>
 #include <pthread.h>
+#include <sys/ioctl.h>
 
+#include "affinity.h"
+#include "capture.h"
+#include "cpu_engine.h"
+#include "histo.h"
 #include "prg_io_nonblock.h"
+#include "render.h"
+#include "ring.h"
+#include "scheduler.h"
+#include "scenes.h"
+#include "trace.h"
+#include "video_sink.h"
 
 #define MY_DEVICE_OUT "/tmp/pipe.out"
 #define MY_DEVICE_IN "/tmp/pipe.in"
@@ -28,9 +42,39 @@
 #define H 480
 #define N_RE 10
 #define N_IM 10
+#define PLAIN_TIMEOUT_MS 100 // the rest of a started plain message, it is corrupted if it does not come
+#define CHUNK_RETRY_S 1.0    // silence after a corrupted chunk or in the middle of a frame
+#define STATS_TIMEOUT_S 0.5  // wait for MSG_STATS of the module at exit
+#define TRACE_MIN_WAIT_NS 20000 // shorter waits for the next event are not traced
+#define HUD_PERIOD_S 0.25    // refresh of the performance overlay
 #include "messages.h"
 #include "xwin_sdl.h"
 
+typedef struct { // receive path statistics reported by the headless run
+   double t_start;   // first compute request
+   double t_end;     // last chunk done
+   long bytes;       // bytes read from the pipe
+   long messages;    // messages parsed
+   long pixels;      // compute data messages
+   int chunks;       // chunks done
+   int local_chunks; // chunks kept from the local workers
+   int duplicated;   // chunks given to both the local workers and the module
+   long mirrored;    // pixels the local workers copied from their point reflection
+   int retried;      // chunks requested again after their data was corrupted
+   double chunk_sent[NUM_CHUNKS];
+   double chunk_latency[NUM_CHUNKS]; // request -> MSG_DONE, taken by a local worker -> polled
+   cpu_stats local;  // the local workers of the frame, threads is 0 without them
+   double cost_corr; // the cost model of the scheduler, see sched_get_cost()
+   double chunk_cost[NUM_CHUNKS];
+   double chunk_work[NUM_CHUNKS];
+} rx_stats;
+
+typedef struct { // a redraw queued to the present thread, see present()
+   bool full;        // the whole window and the video, otherwise only the overlay
+   bool hud_on;      // the overlay of the partial redraw, hidden if false
+   xwin_hud hud;
+} present_req;
+
 
 typedef struct { // shared date structure
    int alarm_period;
@@ -51,10 +95,61 @@ typedef struct { // shared date structure
    bool refresh_screen;
 
    bool compute_done;
+   bool version_received; // the module answered MSG_GET_VERSION
 
    uint8_t n;
 
-
+   video_sink *sink; // optional video stream of the redrawn frames
+
+   const scene_t *scene;
+   bool headless; // no window and no keyboard - render the scene once and report
+   FILE *report;  // headless report, stdout before the messages are moved to stderr
+   rx_stats stats;
+
+   bool cpu;            // --cpu: only the local compute, the pipes are not opened
+   cpu_engine *engine;  // local compute in progress ('c')
+   uint8_t *iters;      // W * H iteration counts of the frame
+
+   bool hybrid;         // --hybrid: the headless run shares the frame with the module
+   bool frame_active;   // local or hybrid frame in progress
+   scheduler *sched;    // chunks of the last local or hybrid frame ('o')
+   int remote_cid;      // chunk of the hybrid frame computed by the module, -1 if idle
+
+   julia_kernel kernel; // float, double or perturbation by the zoom depth of the scene
+   julia_kernel force_kernel; // --kernel, JULIA_KERNELS to select by the zoom depth
+   bool remote_aborted; // one MSG_DONE or MSG_ABORT of an aborted chunk is still to come
+   uint8_t remote_buf[SIZE_C_W * SIZE_C_H]; // remote_cid as it comes, copied into iters if the module keeps it
+
+   frame_reader rx;     // the stream of the module, also counts the corrupted plain messages
+   bool framed;         // the module frames its messages (./module), plain otherwise
+   bool framing_known;  // framed is decided by the first byte of the session
+   bool chunk_bad;      // data of the chunk in flight was lost, it is requested again
+   double t_rx;         // last bytes from the module
+
+   histo *remote_histo; // stage latencies of the module from its last MSG_STATS, NULL if none came
+   julia_kernel remote_kernel; // of the last chunk of the module from its MSG_STATS, JULIA_KERNELS if unknown
+   const char *stages_file; // --stages: JSON of the stage latencies of both processes at exit
+
+   bool hud;            // 'p': performance overlay in the window
+   bool hud_shown;      // the overlay is in the window
+   double hud_t;        // last refresh of the overlay
+   long hud_bytes;      // stats.bytes, stats.pixels and redraws at hud_t
+   long hud_pixels;
+   long hud_redraws;
+   long redraws;        // redraw() calls
+   render *render;      // colour workers and the present thread behind the output thread
+   bool raw_dirty[NUM_CHUNKS]; // raw pixels of the chunk not coloured yet
+   bool raw_queued;  // raw chunks queued to the colour workers since the last render_sync()
+   uint64_t decode_ns;  // the output thread busy with the messages
+   render_stats pipeline; // occupancy of the stages at exit
+   double chunk_s[NUM_CHUNKS]; // compute time of the chunks of the last frame, 0 if unknown
+
+   capture *capture;    // --record: the stream of the module and the requests into a file
+   const char *replay_file; // --replay: the capture in place of the module
+   bool replay_paced;   // --pace: at the recorded pace, otherwise as fast as possible
+   const char *affinity; // --affinity: placement of the threads, NULL for PRGSEM_AFFINITY
+   const char *io;      // --io: backend of the pipe I/O, NULL for PRGSEM_IO
+   replay *replay;
    
 } data_t;
 
@@ -64,14 +159,36 @@ void* input_thread(void*);
 void* output_thread(void*);
 void* alarm_thread(void*);
 bool send_message(data_t *data, message *msg);
-message *buffer_parse(data_t *data, int message_type);
+bool read_message(data_t *data, message *msg, const uint8_t **payload);
+const uint8_t *read_plain(data_t *data, uint8_t type, uint8_t *buf, int *len);
+void retry_chunk(data_t *data);
+void print_stages(data_t *data);
+bool remote_stats(data_t *data, const msg_stats *m, const uint8_t *payload);
+void redraw(data_t *data);
+void present(void *d, const uint8_t *img, const void *arg);
+void update_hud(data_t *data);
+bool parse_args(int argc, char *argv[], data_t *data);
+bool request_chunk(data_t *data, int cid);
+int next_key(data_t *data);
+double get_time(void);
+void print_report(data_t *data);
+void print_schedule(data_t *data, FILE *out);
+void draw_chunk(data_t *data, int cid);
+void draw_raw(data_t *data);
+void print_pipeline(data_t *data, FILE *out);
+bool start_frame(data_t *data, bool hybrid);
+uint8_t *remote_dst(data_t *data, int cid, int *stride);
+void keep_remote(data_t *data, int cid);
+julia_params_dd frame_params(const scene_t *sc);
+julia_kernel frame_kernel(data_t *data, const julia_params_dd *p);
+bool read_payload(data_t *data, uint8_t *buf, int len);
 
 
 
 // - main function -----------------------------------------------------------
 int main(int argc, char *argv[])
 {
-   data_t data = { .alarm_period = 0,.quit = false, .fd = EOF, .is_serial_open = false, .abort = false, .is_cond2_signaled = false, .cid = 0, .compute_used = false, .is_compute_set = false, .refresh_screen = false, .compute_done = false };
+   data_t data = { .alarm_period = 0,.quit = false, .fd = EOF, .is_serial_open = false, .abort = false, .is_cond2_signaled = false, .cid = 0, .compute_used = false, .is_compute_set = false, .refresh_screen = false, .compute_done = false, .scene = &scenes[0], .headless = false, .remote_cid = -1, .force_kernel = JULIA_KERNELS, .remote_kernel = JULIA_KERNELS };
    enum { INPUT, OUTPUT, ALARM, NUM_THREADS };
    const char *threads_names[] = { "Input", "Output", "Alarm", };
 
@@ -86,7 +203,16 @@ int main(int argc, char *argv[])
    data.cond = &cond;              // make the cond accessible from the shared data structure
    data.cond2 = &cond;
 
-   call_termios(0);
+   if (!parse_args(argc, argv, &data)) {
+      return EXIT_FAILURE;
+   }
+
+   if (data.headless) {
+      data.report = fdopen(dup(STDOUT_FILENO), "w"); // keep stdout clean for the report
+      dup2(STDERR_FILENO, STDOUT_FILENO);
+   } else {
+      call_termios(0);
+   }
 
    for (int i = 0; i < NUM_THREADS; ++i) { // create threads 
       int r = pthread_create(&threads[i], NULL, thr_functions[i], &data);
@@ -100,10 +226,129 @@ int main(int argc, char *argv[])
       printf("\033[1;35mTHREAD\033[0m: Joining the thread %s has been %s - exit value %i\r\n", threads_names[i], (r == 0 ? "OK" : "FAIL"), *ex);
    }
 
-   call_termios(1); // restore terminal settings
+   if (!data.headless) {
+      call_termios(1); // restore terminal settings
+   }
+   sink_close(data.sink); // flush the frames still waiting for the encoder
+   if (!trace_close()) {
+      fprintf(stderr, "\033[1;31mERROR\033[0m: Unable to write the trace\n");
+   }
    return EXIT_SUCCESS;
 }
 
+// - function -----------------------------------------------------------------
+bool parse_args(int argc, char *argv[], data_t *data)
+{
+   static const struct option options[] = {
+      { "y4m", required_argument, NULL, 'y' },
+      { "rgb", required_argument, NULL, 'r' },
+      { "scene", required_argument, NULL, 's' },
+      { "headless", no_argument, NULL, 'H' },
+      { "cpu", no_argument, NULL, 'c' },
+      { "hybrid", no_argument, NULL, 'b' },
+      { "kernel", required_argument, NULL, 'k' },
+      { "stages", required_argument, NULL, 't' },
+      { "trace", required_argument, NULL, 'T' },
+      { "record", required_argument, NULL, 'R' },
+      { "replay", required_argument, NULL, 'P' },
+      { "pace", no_argument, NULL, 'p' },
+      { "affinity", required_argument, NULL, 'A' },
+      { "io", required_argument, NULL, 'I' },
+      { "help", no_argument, NULL, 'h' },
+      { NULL, 0, NULL, 0 },
+   };
+   int opt;
+   while ((opt = getopt_long(argc, argv, "h", options, NULL)) != -1) {
+      switch (opt) {
+         case 'y':
+         case 'r':
+            if (data->sink) {
+               fprintf(stderr, "\033[1;31mERROR\033[0m: Only one video output can be set\n");
+               return false;
+            }
+            data->sink = sink_open(optarg, opt == 'y' ? SINK_Y4M : SINK_RGB, W, H, 25);
+            if (data->sink == NULL) {
+               return false;
+            }
+            break;
+         case 's':
+            data->scene = scene_find(optarg);
+            if (data->scene == NULL) {
+               fprintf(stderr, "\033[1;31mERROR\033[0m: Unknown scene '%s'\n", optarg);
+               return false;
+            }
+            break;
+         case 'H':
+            data->headless = true;
+            break;
+         case 'c':
+            data->cpu = true;
+            break;
+         case 'b':
+            data->hybrid = true;
+            break;
+         case 'k':
+            data->force_kernel = julia_kernel_find(optarg);
+            if (data->force_kernel == JULIA_KERNELS && strcmp(optarg, "auto")) {
+               fprintf(stderr, "\033[1;31mERROR\033[0m: Unknown kernel '%s'\n", optarg);
+               return false;
+            }
+            break;
+         case 't':
+            data->stages_file = optarg;
+            break;
+         case 'T':
+            trace_open(optarg, "prgsem-main");
+            break;
+         case 'R':
+            data->capture = capture_open(optarg);
+            if (data->capture == NULL) {
+               fprintf(stderr, "\033[1;31mERROR\033[0m: Unable to open the file %s\n", optarg);
+               return false;
+            }
+            break;
+         case 'P':
+            data->replay_file = optarg;
+            break;
+         case 'p':
+            data->replay_paced = true;
+            break;
+         case 'A':
+            data->affinity = optarg;
+            break;
+         case 'I':
+            data->io = optarg;
+            break;
+         default:
+            fprintf(stderr, "usage: %s [--scene NAME] [--headless] [--cpu | --hybrid] [--kernel K] [--stages FILE] [--trace FILE] [--record FILE | --replay FILE [--pace]] [--affinity P] [--io B] [--y4m FILE | --rgb FILE]\n", argv[0]);
+            fprintf(stderr, "  --scene NAME scene to render: default, interior, zoom, deep\n");
+            fprintf(stderr, "  --headless   no window, render the scene once and print a JSON report\n");
+            fprintf(stderr, "  --cpu        compute locally only, without the module and the pipes\n");
+            fprintf(stderr, "  --hybrid     the headless run shares the frame between the cpu and the module\n");
+            fprintf(stderr, "  --kernel K   local kernel: auto (default), float, double, dd, perturb, float128\n");
+            fprintf(stderr, "  --stages FILE  write the stage latency histograms of both processes as JSON at exit\n");
+            fprintf(stderr, "  --trace FILE write the spans of this process as a Chrome trace at exit\n");
+            fprintf(stderr, "  --record FILE  capture the stream of the module with its timing\n");
+            fprintf(stderr, "  --replay FILE  play a capture back in place of the module, --pace at the recorded pace\n");
+            fprintf(stderr, "  --affinity P thread placement: off, auto or COMPUTE/IO cpu lists (default $%s)\n", AFFINITY_ENV);
+            fprintf(stderr, "  --io B       I/O of the pipes and the video: posix or uring (default $%s)\n", IO_BACKEND_ENV);
+            fprintf(stderr, "  --y4m FILE   stream redrawn frames as YUV4MPEG2 ('-' for stdout)\n");
+            fprintf(stderr, "  --rgb FILE   stream redrawn frames as raw rgb24 ('-' for stdout)\n");
+            return false;
+      }
+   }
+   if (data->cpu && data->hybrid) {
+      fprintf(stderr, "\033[1;31mERROR\033[0m: --hybrid needs the module, it cannot be used with --cpu\n");
+      return false;
+   }
+   if (data->replay_file && (data->cpu || data->hybrid || data->capture)) {
+      // the local workers would take the chunks of the capture
+      fprintf(stderr, "\033[1;31mERROR\033[0m: --replay cannot be used with --cpu, --hybrid or --record\n");
+      return false;
+   }
+   return affinity_init(data->affinity) && io_backend(data->io);
+}
+
 // - function -----------------------------------------------------------------
 void call_termios(int reset)
 {
@@ -125,6 +370,8 @@ void* input_thread(void* d)
    static int r = 0;
    int c;
    bool qq = false;
+   trace_thread("input");
+   affinity_pin(AFFINITY_IO, 0, "input");
    
    
    while((!qq)){ // until pipe isnt open - dont do anything
@@ -133,7 +380,7 @@ void* input_thread(void* d)
       pthread_mutex_unlock(data->mtx);
    }
    message msg2;
-   while ((c = getchar()) != 'q') {
+   while ((c = next_key(data)) != 'q') {
       pthread_mutex_lock(data->mtx);
       int period = data->alarm_period;
       switch (c) {
@@ -150,20 +397,39 @@ void* input_thread(void* d)
             break;
          case 's':
          {
+            if (!data->version_received) { // the framing, and so the message the module understands, comes with its answer
+               printf("\033[1;33mWARNING\033[0m: The module has not answered yet\r\n");
+               printf("\033[1;32mHINT:\033[0m: Press g to get its version, then s\r\n");
+               break;
+            }
+            const bool framed = data->framed; // set by the read thread
             pthread_mutex_unlock(data->mtx);
-            msg2 = (message){.type = MSG_SET_COMPUTE, .data.set_compute = { .c_re = -0.4, .c_im = 0.6, .d_re = 0.005, .d_im = (double)-11/2400, .n = 60}};
-            data->n = 60;
+            const scene_t *sc = data->scene;
+            const julia_params_dd p = frame_params(sc);
+            data->kernel = frame_kernel(data, &p);
+            if (!framed && !julia_kernel_dd(data->kernel)) { // the reference module knows only this one
+               msg2 = (message){.type = MSG_SET_COMPUTE, .data.set_compute = { .c_re = sc->c_re, .c_im = sc->c_im, .d_re = sc->d_re, .d_im = sc->d_im, .n = sc->n}};
+            } else { // ./module computes every chunk of the frame with our kernel
+               msg2 = (message){.type = MSG_SET_COMPUTE_HP, .data.set_compute_hp = { .c_re = {p.c_re.hi, p.c_re.lo}, .c_im = {p.c_im.hi, p.c_im.lo}, .d_re = {p.d_re.hi, p.d_re.lo}, .d_im = {p.d_im.hi, p.d_im.lo}, .n = sc->n, .kernel = data->kernel}};
+            }
+            data->n = sc->n;
             send_message(data, &msg2);
             fsync(data->fd); // sync the data
             data->is_compute_set = true;
             pthread_mutex_lock(data->mtx);
-            printf("\033[1;34mINFO\033[0m: Set compute message sent\r\n");
+            printf("\033[1;34mINFO\033[0m: Set compute message sent (%s kernel)\r\n", julia_kernel_name(data->kernel));
          
          }
          break;
          case '1':
          {  
             pthread_mutex_unlock(data->mtx);
+            if(data->cpu){
+               printf("\033[1;33mWARNING\033[0m: The module is not connected (--cpu)\r\n");
+               printf("\033[1;32mHINT:\033[0m: If you want to compute locally, press c\r\n");
+               pthread_mutex_lock(data->mtx);
+               break;
+            }
             if(!data->is_compute_set){
                printf("\033[1;33mWARNING\033[0m: Compute message is not set\r\n");
                printf("\033[1;32mHINT:\033[0m: If you want to set compute message, press s\r\n");
@@ -184,18 +450,58 @@ void* input_thread(void* d)
             }
             data->abort = false;
 
-            double re = -1.6; //start of the x-coords (real]
-            double im =1.1; //start of the y-coords (imaginary)
             data->prev_cid = data->cid;
-            msg2 = (message){.type = MSG_COMPUTE, .data.compute = { .cid = data->cid, .re = re, .im = im ,.n_re = N_RE, .n_im = N_IM}};
-            send_message(data, &msg2);
-            fsync(data->fd); // sync the data
             data->compute_used = true;
+            if (data->cid == 0) { // a new frame, the colour workers are done with the last one
+               pthread_mutex_lock(data->mtx);
+               render_sync(data->render);
+               pthread_mutex_unlock(data->mtx);
+               data->stats = (rx_stats){ .t_start = get_time() };
+            }
+            request_chunk(data, data->cid); // the next chunk is requested on its MSG_DONE
             pthread_mutex_lock(data->mtx);
           
          }
          break;
 
+         case 'c':
+         case 'h':
+         {
+            if(c == 'h' && data->cpu){
+               printf("\033[1;33mWARNING\033[0m: The module is not connected (--cpu)\r\n");
+               printf("\033[1;32mHINT:\033[0m: If you want to compute locally, press c\r\n");
+               break;
+            }
+            if(c == 'h' && !data->is_compute_set){
+               printf("\033[1;33mWARNING\033[0m: Compute message is not set\r\n");
+               printf("\033[1;32mHINT:\033[0m: If you want to set compute message, press s\r\n");
+               break;
+            }
+            if(data->compute_used || data->frame_active || (c == 'h' && data->remote_aborted)){
+               printf("\033[1;33mWARNING\033[0m: Compute thread is already running\r\n");
+               printf("\033[1;32mHINT:\033[0m: If you want to abort computation, press a\r\n");
+               break;
+            }
+            bool ok = start_frame(data, c == 'h');
+            printf("\033[1;34mINFO\033[0m: %s compute %s\r\n", c == 'h' ? "Hybrid" : "Local", ok ? "started" : "failed");
+         }
+         break;
+
+         case 'p':
+         {
+            data->hud = !data->hud; // drawn by the output thread, it owns the window
+         }
+         break;
+         case 'o':
+         {
+            if(data->sched){
+               sched_print(data->sched, stdout, N_RE);
+            } else {
+               printf("\033[1;33mWARNING\033[0m: No local or hybrid frame has been computed\r\n");
+            }
+         }
+         break;
+
          case 'l':
          {
             if(!data->compute_used)
@@ -210,6 +516,14 @@ void* input_thread(void* d)
 
          case 'a':
          {
+            if (data->engine) {
+               cpu_abort(data->engine);
+            }
+            if (data->remote_cid >= 0) { // the hybrid chunk of the module
+               sched_release(data->sched, data->remote_cid, SCHED_REMOTE);
+               data->remote_cid = -1;
+               data->remote_aborted = true;
+            }
             pthread_mutex_unlock(data->mtx);
             data->abort = true;
             data->compute_used = false;
@@ -221,6 +535,23 @@ void* input_thread(void* d)
             pthread_mutex_lock(data->mtx);
          }
          break;
+         case 't':
+         {
+            histo *h = malloc(sizeof(histo));
+            if (h) {
+               histo_collect(h);
+               histo_print(h, "prgsem-main", stdout);
+               free(h);
+            }
+            if (data->framed) { // ./module answers by MSG_STATS, printed when it comes
+               pthread_mutex_unlock(data->mtx);
+               msg2 = (message){.type = MSG_GET_STATS,};
+               send_message(data, &msg2);
+               fsync(data->fd); // sync the data
+               pthread_mutex_lock(data->mtx);
+            }
+         }
+         break;
          case 'r':
          {
             pthread_mutex_unlock(data->mtx);
@@ -252,58 +583,95 @@ void* output_thread(void* d)
    data_t *data = (data_t*)d;
    static int r = 0;
    bool q = false;
-   data->fd = io_open_write(MY_DEVICE_OUT);
-   if (data->fd == EOF) {
-      fprintf(stderr, "\033[1;31mERROR\033[0m: Unable to open the file %s\n", MY_DEVICE_OUT);
-      exit(1);
+   trace_thread("output");
+   affinity_pin(AFFINITY_IO, 0, "output"); // reads the pipe and presents the window
+   if (data->replay_file) {
+      data->replay = replay_start(data->replay_file, data->replay_paced, &data->rd, &data->fd);
+      if (data->replay == NULL) {
+         fprintf(stderr, "\033[1;31mERROR\033[0m: Unable to replay the file %s\n", data->replay_file);
+         exit(1);
+      }
+   } else if (!data->cpu) {
+      data->fd = io_open_write(MY_DEVICE_OUT);
+      if (data->fd == EOF) {
+         fprintf(stderr, "\033[1;31mERROR\033[0m: Unable to open the file %s\n", MY_DEVICE_OUT);
+         exit(1);
+      }
+      data->rd = io_open_read(MY_DEVICE_IN);
+      if (data->rd == EOF){
+         fprintf(stderr, "\033[1;31mERROR\033[0m: Unable to open the file %s\n", MY_DEVICE_IN);
+         exit(1); // not coding style but whatever
+      }
+   }
+   if (!data->cpu) {
+      message msg  = {.type = MSG_STARTUP, .data.startup = { .message = "Henlo"}};
+      send_message(data, &msg);
    }
-   data->rd = io_open_read(MY_DEVICE_IN);
-   if (data->rd == EOF){
-        fprintf(stderr, "\033[1;31mERROR\033[0m: Unable to open the file %s\n", MY_DEVICE_IN);
-        exit(1); // not coding style but whatever
-    }
-   message msg  = {.type = MSG_STARTUP, .data.startup = { .message = "Henlo"}};
-   send_message(data, &msg);
 
 
    //open SDL window
-   xwin_init(W, H);
+   if (!data->headless) {
+      xwin_init(W, H);
+   }
   
    unsigned char *img = malloc(W * H * 3);  // 3 bytes per pixel for RGB
-   if (img == NULL) {
+   data->iters = calloc(W * H, 1);
+   if (img == NULL || data->iters == NULL) {
       fprintf(stderr, "Failed to allocate memory for image\n");
       exit(1);
    }
-
- 
-
-   for (int y = 0; y < H; ++y) { // fill the image with some color
-            for (int x = 0; x < W; ++x) {
-               int idx = (y * W + x) * 3;
-               img[idx] = 100; // red component
-               img[idx + 1] = 0; // green component
-               img[idx + 2] = 10; // blue component
-            }
+   // from now on the image belongs to the colour workers and the present thread
+   data->render = render_create(img, data->iters, W, H, 0, sizeof(present_req), present, data);
+   if (data->render == NULL) {
+      exit(1);
    }
-   xwin_redraw(W, H, img);
+
+   render_fill(data->render, 100, 0, 10); // fill the image with some color
+   redraw(data);
    
 
-   if (io_putc(data->fd, 'i') != 1) { // sends init byte
+   if (!data->cpu && io_putc(data->fd, 'i') != 1) { // sends init byte
       fprintf(stderr, "\033[1;31mERROR\033[0m: Unable to send the init byte\n");
       exit(1);
    }
    fsync(data->fd); // sync the data
    pthread_mutex_lock(data->mtx);
    data->is_serial_open = true;
+   bool more = false; // a message came, the next one may be waiting already
    while (!q) { // main loop for data output
-      pthread_cond_wait(data->cond, data->mtx); // wait for next event
+      if (more) { // drain the pipe, only let the input thread in between
+         pthread_mutex_unlock(data->mtx);
+         pthread_mutex_lock(data->mtx);
+      } else {
+         const uint64_t w0 = TRACE_BEGIN();
+         pthread_cond_wait(data->cond, data->mtx); // wait for next event
+         if (w0 && histo_now() - w0 >= TRACE_MIN_WAIT_NS) { // a bubble, the alarm thread did not wake us
+            trace_span("wait", w0, -1);
+         }
+      }
+      const uint64_t d0 = histo_now();
       uint8_t c = '\0'; 
-      io_getc_timeout(data->rd, 0,&c); 
+      message msg;
+      const uint8_t *payload = NULL;
+      if (!data->cpu && read_message(data, &msg, &payload)) {
+         c = msg.type;
+      }
+      more = c != '\0';
+      if ((data->chunk_bad || data->rx.len > data->rx.pos + data->rx.taken) && get_time() - data->t_rx > CHUNK_RETRY_S) {
+         data->t_rx = get_time();
+         if (data->rx.len > data->rx.pos + data->rx.taken) {
+            // silence in the middle of a frame (a truncated write), the
+            // frames behind it are scanned first, MSG_DONE may be among them
+            frame_drop(&data->rx);
+            data->chunk_bad = true;
+         } else { // MSG_DONE of the corrupted chunk was lost as well
+            retry_chunk(data);
+         }
+      }
       if(c == MSG_VERSION){
          //printf("Version message recieved:");
-         message *msg = buffer_parse(data, MSG_VERSION);
-         printf("\033[1;32mVERSION\033[0m: %c. %c. %c\r\n", msg->data.version.major, msg->data.version.minor, msg->data.version.patch);
-         free(msg);
+         printf("\033[1;32mVERSION\033[0m: %c. %c. %c\r\n", msg.data.version.major, msg.data.version.minor, msg.data.version.patch);
+         data->version_received = true;
          c = '\0';
       }
       if(c == MSG_ERROR){
@@ -313,97 +681,237 @@ void* output_thread(void* d)
       if(data->refresh_screen){
          printf("\033[1;34mINFO\033[0m: Refreshing screen\r\n");
          data->refresh_screen = false;
-            for (int y = 0; y < H; ++y) { // fill the image with some color
-            for (int x = 0; x < W; ++x) {
-               int idx = (y * W + x) * 3;
-               img[idx] = 100; // red component
-               img[idx + 1] = 0; // green component
-               img[idx + 2] = 10; // blue component
-            }
+         memset(data->raw_dirty, 0, sizeof(data->raw_dirty));
+         render_fill(data->render, 100, 0, 10); // fill the image with some color
+         redraw(data);
+      }
+
+      if(data->engine){ // chunks finished by the local workers
+         bool running = cpu_running(data->engine); // before the poll, so no chunk is missed
+         int cids[NUM_CHUNKS];
+         int n = cpu_poll(data->engine, cids, NUM_CHUNKS);
+         double t = get_time();
+         for (int i = 0; i < n; ++i) {
+            draw_chunk(data, cids[i]);
+            data->stats.chunk_latency[cids[i]] = t - cpu_chunk_taken(data->engine, cids[i]);
+            data->chunk_s[cids[i]] = cpu_chunk_time(data->engine, cids[i]);
+         }
+         data->stats.chunks += n;
+         data->stats.local_chunks += n;
+         data->stats.pixels += n * SIZE_C_W * SIZE_C_H;
+         if (n > 0) {
+            more = true;
+            redraw(data);
+         }
+         if (!running) {
+            data->stats.mirrored = cpu_mirrored(data->engine);
+            cpu_get_stats(data->engine, &data->stats.local);
+            cpu_finish(data->engine);
+            data->engine = NULL;
+         }
+      }
+
+      if(data->frame_active && data->remote_cid >= 0 && sched_complete(data->sched)){
+         // the chunk of the module has been finished by the local workers, stop it
+         sched_release(data->sched, data->remote_cid, SCHED_REMOTE);
+         data->remote_cid = -1;
+         data->remote_aborted = true;
+         pthread_mutex_unlock(data->mtx);
+         message msg = {.type = MSG_ABORT};
+         send_message(data, &msg);
+         fsync(data->fd); // sync the data
+         pthread_mutex_lock(data->mtx);
+      }
+
+      if(data->frame_active && !data->engine && data->remote_cid < 0){ // both sides are idle
+         sched_stats st;
+         sched_get_stats(data->sched, &st);
+         data->stats.duplicated = st.duplicated;
+         data->stats.cost_corr = st.cost_corr;
+         sched_get_cost(data->sched, data->stats.chunk_cost, data->stats.chunk_work);
+         data->frame_active = false;
+         data->compute_used = false;
+         if (st.done == st.chunks) {
+            double t = get_time();
+            printf("\033[1;34mINFO\033[0m: Frame done in %.3f s, %d local and %d remote chunks\r\n", t - data->stats.t_start, st.kept[SCHED_LOCAL], st.kept[SCHED_REMOTE]);
+            data->stats.t_end = t;
+            data->compute_done = true;
+            print_schedule(data, stdout);
+         }
+         if (data->headless && data->hybrid) {
+            sched_print(data->sched, stdout, N_RE);
          }
-         xwin_redraw(W, H, img);
+      }
+
+      if(c == MSG_ABORT){
+         printf("\033[1;34mINFO\033[0m: Module aborted the computation\r\n");
+         data->remote_aborted = false;
+         c = '\0';
       }
 
       if(c == MSG_DONE){
          //printf("Done message recieved:");
-         message *msg = buffer_parse(data, MSG_DONE);
-         printf("\033[1;34mINFO\033[0m: Done message recieved\r\n");
-         data->compute_used = false;
-         data->compute_done = true;
-         free(msg);
+         double t = get_time();
+         if (data->remote_aborted) { // the chunk was done before the abort came
+            data->remote_aborted = false;
+            data->chunk_bad = false;
+         } else if (data->chunk_bad) { // some of its data was lost, the same chunk again
+            retry_chunk(data);
+         } else if (data->remote_cid >= 0) { // hybrid frame, the next chunk from the scheduler
+            const int cid = data->remote_cid;
+            data->stats.chunk_latency[cid] = t - data->stats.chunk_sent[cid];
+            data->chunk_s[cid] = data->stats.chunk_latency[cid];
+            if (sched_finish(data->sched, cid, SCHED_REMOTE)) {
+               keep_remote(data, cid);
+               data->stats.chunks += 1;
+               redraw(data);
+            }
+            data->remote_cid = data->abort ? -1 : sched_take(data->sched, SCHED_REMOTE);
+            if (data->remote_cid >= 0) {
+               pthread_mutex_unlock(data->mtx);
+               request_chunk(data, data->remote_cid);
+               pthread_mutex_lock(data->mtx);
+            }
+         } else {
+            data->stats.chunk_latency[data->cid] = t - data->stats.chunk_sent[data->cid];
+            data->chunk_s[data->cid] = data->stats.chunk_latency[data->cid];
+            data->stats.chunks += 1;
+            redraw(data); // one chunk per MSG_DONE
+            int next = data->cid + 1;
+            if (next < NUM_CHUNKS && data->compute_used && !data->abort) {
+               data->cid = data->prev_cid = next;
+               pthread_mutex_unlock(data->mtx);
+               request_chunk(data, next);
+               pthread_mutex_lock(data->mtx);
+            } else if (next == NUM_CHUNKS) {
+               printf("\033[1;34mINFO\033[0m: Done message recieved\r\n");
+               data->stats.t_end = t;
+               data->compute_used = false;
+               data->compute_done = true;
+            }
+         }
          c = '\0';
       }
 
 
       if(c == MSG_COMPUTE_DATA){
          //printf("Compute data recieved:");
-         message *msg = buffer_parse(data, MSG_COMPUTE_DATA);
-      
-         uint8_t i_re = msg->data.compute_data.i_re;
-         uint8_t i_im = msg->data.compute_data.i_im;
+         uint8_t i_re = msg.data.compute_data.i_re;
+         uint8_t i_im = msg.data.compute_data.i_im;
+         data->stats.pixels += 1;
 
-         int x_im = (msg->data.compute_data.cid % 10)*64;  // starting pos for redraw - one chunk
-         int y_im = (msg->data.compute_data.cid / 10)*48;
+         int x_im = (msg.data.compute_data.cid % 10)*64;  // starting pos for redraw - one chunk
+         int y_im = (msg.data.compute_data.cid / 10)*48;
 
-         data->cid = msg->data.compute_data.cid;
+         if (msg.data.compute_data.cid < NUM_CHUNKS) {
+            data->cid = msg.data.compute_data.cid;
+         }
          
         
          int x = x_im + i_re;  // x coordinate of the pixel in the image
          int y = y_im + i_im;  // y coordinate of the pixel in the image
-         int idx = (y * W + x) * 3;  // index of the pixel in the 1D array
-
-         double t = (double)msg->data.compute_data.iter / data->n; // t is in [0, 1]
-         
-         if(t == 1){
-            uint8_t red = 0; // red component
-            uint8_t green = 0; // green component
-            uint8_t blue = 0; // blue component
-
-            img[idx] = red; // red component
-            img[idx + 1] = green; // green component
-            img[idx + 2] = blue; // blue component
-
+         // ignore pixels outside of the chunk and of the hybrid chunks that already have a result
+         int stride;
+         uint8_t *dst = i_re < SIZE_C_W && i_im < SIZE_C_H && msg.data.compute_data.cid < NUM_CHUNKS ? remote_dst(data, msg.data.compute_data.cid, &stride) : NULL;
+         if (dst == data->remote_buf) { // hybrid frame, kept or dropped by MSG_DONE
+            dst[i_im * stride + i_re] = msg.data.compute_data.iter;
+         } else if (dst) {
+            if (data->raw_queued) { // a chunk coloured by the last redraw may be this one
+               render_sync(data->render);
+               data->raw_queued = false;
+            }
+            data->iters[y * W + x] = msg.data.compute_data.iter;
+            data->raw_dirty[msg.data.compute_data.cid] = true; // coloured as a whole before the next redraw
          }
-         else{
 
-            uint8_t red = (uint8_t)(9 * (1 - t) * t * t * t * 255); // red component
-            uint8_t green = (uint8_t)(15 * (1 - t) * (1 - t) * t * t * 255); // green component
-            uint8_t blue = (uint8_t)(8.5 * (1 - t) * (1 - t) * (1 - t) * t * 255); // blue component
+         data->prev_cid = data->cid;
 
-            img[idx] = red; // red component
-            img[idx + 1] = green; // green component
-            img[idx + 2] = blue; // blue component
-         }
 
-         
-         if(data->cid != data->prev_cid){ // if the chunk is done (cid changed
-            xwin_redraw(W, H, img);
-         }
+         c = '\0';
+      }
 
-         else if(data->cid == 99 && idx == 3*W*H){ // if the last chunk is done
-            xwin_redraw(W, H, img);
+      if(c == MSG_COMPUTE_DATA_PACKED){ // the whole chunk of ./module, decoded straight into iters or staged
+         const msg_compute_data_packed *pk = &msg.data.compute_data_packed;
+         const int cid = pk->cid;
+         int stride;
+         uint8_t *dst = cid < NUM_CHUNKS && pk->n_re <= SIZE_C_W && pk->n_im <= SIZE_C_H ? remote_dst(data, cid, &stride) : NULL;
+         if (dst) {
+            data->cid = data->prev_cid = cid;
+            const uint64_t s0 = TRACE_BEGIN();
+            const uint64_t t0 = HISTO_NOW();
+            const bool ok = unpack_chunk(payload, pk->len, pk->n_re, pk->n_im, dst, stride);
+            HISTO_ADD(STAGE_DECODE, HISTO_NOW() - t0);
+            TRACE_END("unpack", s0, cid);
+            if (ok) {
+               data->stats.pixels += pk->n_re * pk->n_im;
+               if (dst != data->remote_buf) {
+                  draw_chunk(data, cid);
+               }
+            } else {
+               printf("\033[1;33mWARNING\033[0m: Corrupted packed chunk %d dropped\r\n", cid);
+               data->rx.corrupt += data->framed; // the frame crc leaves its payload to unpack_chunk()
+               data->chunk_bad = true;
+            }
          }
-         data->prev_cid = data->cid;
-
+         c = '\0';
+      }
 
-         free(msg);
+      if(c == MSG_STATS){ // the answer to 't' or to the request at exit
+         if (remote_stats(data, &msg.data.stats, payload)) {
+            histo_print(data->remote_histo, "module", stdout);
+         }
          c = '\0';
       }
+      update_hud(data);
+      if (more) {
+         data->decode_ns += histo_now() - d0;
+      }
    q = data->quit;
    fflush(stdout);
    }
    pthread_mutex_unlock(data->mtx);
-
-   if (io_putc(data->fd, 'q') != 1) { // sends exit byte
-      fprintf(stderr, "\033[1;31mERROR\033[0m: Unable to send the end byte\r\n");
-      exit(1);
+   cpu_finish(data->engine);
+   sched_free(data->sched);
+
+   if (data->framed) { // the histograms of ./module before it quits
+      message msg = {.type = MSG_GET_STATS};
+      send_message(data, &msg);
+      fsync(data->fd); // sync the data
+      const double t = get_time();
+      while (get_time() - t < STATS_TIMEOUT_S) {
+         const uint8_t *payload = NULL;
+         if (!read_message(data, &msg, &payload)) {
+            usleep(1000);
+         } else if (msg.type == MSG_STATS) {
+            remote_stats(data, &msg.data.stats, payload);
+            break;
+         }
+      }
    }
-   fsync(data->fd); // sync the data
-   io_close(data->fd);
-   io_close(data->rd);
+   print_stages(data);
+   render_free(data->render, &data->pipeline); // the frames still queued are presented
+   print_pipeline(data, data->headless ? stderr : stdout);
+
+   if (!data->cpu) {
+      if (io_putc(data->fd, 'q') != 1) { // sends exit byte
+         fprintf(stderr, "\033[1;31mERROR\033[0m: Unable to send the end byte\r\n");
+         exit(1);
+      }
+      fsync(data->fd); // sync the data
+      io_close(data->fd);
+      io_close(data->rd);
+   }
+   replay_finish(data->replay);
+   capture_close(data->capture);
    fprintf(stderr, "\033[1;35mTHREAD\033[0m: Exit output thread %lu\r\n", (unsigned long)pthread_self());
-   xwin_close();
+   if (data->headless) {
+      print_report(data);
+   } else {
+      xwin_close();
+   }
    free(img);
+   free(data->iters);
+   free(data->remote_histo);
    return &r;
 }
 
@@ -414,6 +922,8 @@ void* alarm_thread(void* d)
 {
    data_t *data = (data_t*)d;
    bool qq = false;
+   trace_thread("alarm");
+   affinity_pin(AFFINITY_IO, 0, "alarm");
    while((!qq)){ // until pipe isnt open - dont do anything
       pthread_mutex_lock(data->mtx); 
       qq = data->is_serial_open;
@@ -432,7 +942,9 @@ void* alarm_thread(void* d)
       q = data->quit;
       pthread_cond_broadcast(data->cond); // broadcast condition for output thread - to prevent buffer overflow
       pthread_mutex_unlock(data->mtx);
-      xwin_poll_events();
+      if (!data->headless) {
+         xwin_poll_events();
+      }
 
       
    }
@@ -443,6 +955,324 @@ void* alarm_thread(void* d)
 
 
 
+// colourise one chunk of the iteration grid into the image, by the colour workers
+void draw_chunk(data_t *data, int cid){
+   render_colour(data->render, (cid % N_RE) * SIZE_C_W, (cid / N_RE) * SIZE_C_H, SIZE_C_W, SIZE_C_H, data->n);
+   data->raw_dirty[cid] = false;
+}
+
+// the chunks of raw pixels are coloured whole, once per redraw
+void draw_raw(data_t *data){
+   for (int cid = 0; cid < NUM_CHUNKS; ++cid) {
+      if (data->raw_dirty[cid]) {
+         draw_chunk(data, cid);
+         data->raw_queued = true;
+      }
+   }
+}
+
+// local ('c') or hybrid ('h') compute of the whole frame, called with data->mtx locked
+bool start_frame(data_t *data, bool hybrid){
+   const julia_params_dd p = frame_params(data->scene);
+   render_sync(data->render); // the colour workers are done with the last frame
+   sched_free(data->sched);
+   data->sched = sched_create(NUM_CHUNKS);
+   if (data->sched == NULL) {
+      return false;
+   }
+   data->n = p.n;
+   data->abort = false;
+   data->compute_done = false;
+   data->kernel = frame_kernel(data, &p);
+   data->stats = (rx_stats){ .t_start = get_time() };
+   data->engine = cpu_start(&p, data->kernel, W, H, SIZE_C_W, SIZE_C_H, data->iters, 0, data->sched);
+   data->frame_active = data->compute_used = data->engine != NULL;
+   if (hybrid && data->frame_active) { // the module takes its chunks from the same scheduler
+      data->remote_cid = sched_take(data->sched, SCHED_REMOTE);
+      if (data->remote_cid >= 0) {
+         pthread_mutex_unlock(data->mtx);
+         request_chunk(data, data->remote_cid);
+         pthread_mutex_lock(data->mtx);
+      }
+   }
+   return data->frame_active;
+}
+
+// the whole window and a frame of the video, queued to the present thread
+void redraw(data_t *data){
+   const present_req req = { .full = true };
+   data->redraws += 1;
+   draw_raw(data);
+   render_present(data->render, &req);
+}
+
+// the present thread: the image is whole, nothing colours it until the return
+void present(void *d, const uint8_t *img, const void *arg){
+   data_t *data = (data_t*)d;
+   const present_req *req = (const present_req*)arg;
+   const uint64_t s0 = TRACE_BEGIN();
+   const uint64_t t0 = HISTO_NOW();
+   if (!req->full) { // the overlay only
+      xwin_set_hud(req->hud_on ? &req->hud : NULL);
+      xwin_redraw_hud(W, H, img);
+   } else {
+      if (!data->headless) {
+         xwin_redraw(W, H, (unsigned char*)img);
+      }
+      if (data->sink) {
+         sink_push(data->sink, img); // blocks only when the encoder is two frames behind
+      }
+   }
+   HISTO_ADD(STAGE_BLIT, HISTO_NOW() - t0);
+   TRACE_END(req->full ? "redraw" : "redraw hud", s0, -1);
+}
+
+// where the data of a chunk from the module goes: iters, or in a hybrid frame the
+// staging buffer, as the local workers may finish the same chunk meanwhile;
+// NULL if it is stale (not the chunk of the module or already done)
+uint8_t *remote_dst(data_t *data, int cid, int *stride){
+   if (data->frame_active || data->remote_aborted) {
+      *stride = SIZE_C_W;
+      return data->frame_active && cid == data->remote_cid && !sched_is_done(data->sched, cid) ? data->remote_buf : NULL;
+   }
+   *stride = W;
+   return data->iters + (cid / N_RE) * SIZE_C_H * W + (cid % N_RE) * SIZE_C_W;
+}
+
+// the staged chunk of the module won against the local workers, called after
+// sched_finish() returned true, so nobody else writes the chunk in iters
+void keep_remote(data_t *data, int cid){
+   uint8_t *dst = data->iters + (cid / N_RE) * SIZE_C_H * W + (cid % N_RE) * SIZE_C_W;
+   for (int y = 0; y < SIZE_C_H; ++y) {
+      memcpy(dst + y * W, data->remote_buf + y * SIZE_C_W, SIZE_C_W);
+   }
+   draw_chunk(data, cid);
+}
+
+// the performance overlay ('p') every HUD_PERIOD_S, only its part of the window is repainted
+void update_hud(data_t *data){
+   const double t = get_time();
+   if (data->headless || (!data->hud && !data->hud_shown) || (data->hud == data->hud_shown && t - data->hud_t < HUD_PERIOD_S)) {
+      return;
+   }
+   const rx_stats *st = &data->stats;
+   const double dt = data->hud_shown ? t - data->hud_t : 0; // no rates in the first refresh
+   // the stats restart with every frame
+   const long bytes = st->bytes >= data->hud_bytes ? st->bytes - data->hud_bytes : st->bytes;
+   const long pixels = st->pixels >= data->hud_pixels ? st->pixels - data->hud_pixels : st->pixels;
+   present_req req = { .hud_on = data->hud, .hud = { .n_re = N_RE, .n_im = N_IM } };
+   xwin_hud *hud = &req.hud;
+   int queue = 0; // bytes of the module not read yet
+   if (!data->cpu && data->rd != EOF && ioctl(data->rd, FIONREAD, &queue) < 0) {
+      queue = 0;
+   }
+   if (data->rx.len > data->rx.pos + data->rx.taken) {
+      queue += data->rx.len - data->rx.pos - data->rx.taken;
+   }
+   const int local = data->engine ? cpu_busy(data->engine) : 0;
+   const int remote = data->remote_cid >= 0 || (data->compute_used && !data->frame_active && !data->compute_done);
+   double max = 0;
+   for (int i = 0; i < NUM_CHUNKS; ++i) {
+      max = data->chunk_s[i] > max ? data->chunk_s[i] : max;
+   }
+   for (int i = 0; i < NUM_CHUNKS; ++i) {
+      hud->heat[i] = data->chunk_s[i] > 0 ? data->chunk_s[i] / max : -1;
+   }
+   snprintf(hud->line[0], sizeof(hud->line[0]), "FPS %.1f", dt > 0 ? (data->redraws - data->hud_redraws) / dt : 0);
+   snprintf(hud->line[1], sizeof(hud->line[1]), "PIXELS/S %.2fM", dt > 0 ? pixels / dt * 1e-6 : 0);
+   snprintf(hud->line[2], sizeof(hud->line[2]), "PIPE %.1f KB/S", dt > 0 ? bytes / dt * 1e-3 : 0);
+   snprintf(hud->line[3], sizeof(hud->line[3]), "IN FLIGHT L%d R%d", local, remote);
+   snprintf(hud->line[4], sizeof(hud->line[4]), "QUEUE %d B", queue);
+   snprintf(hud->line[5], sizeof(hud->line[5]), "CHUNK MAX %.1f MS", max * 1e3);
+   draw_raw(data);
+   render_present(data->render, &req);
+   data->hud_shown = data->hud;
+   data->hud_t = t;
+   data->hud_bytes = st->bytes;
+   data->hud_pixels = st->pixels;
+   data->hud_redraws = data->redraws;
+}
+
+// parameters of the whole frame, pixel (0, 0) is the upper left corner of the scene
+julia_params_dd frame_params(const scene_t *sc){
+   return (julia_params_dd){ {sc->c_re, 0}, {sc->c_im, 0}, {sc->re, 0}, {sc->im, 0}, {sc->d_re, 0}, {sc->d_im, 0}, sc->n };
+}
+
+// the kernel of the whole frame, --kernel overrides the choice by the zoom depth
+julia_kernel frame_kernel(data_t *data, const julia_params_dd *p){
+   return data->force_kernel < JULIA_KERNELS ? data->force_kernel : julia_select(p, W, H);
+}
+
+// ask the module for one chunk - the same request the reference module expects,
+// the origin in double-double if the deep zoom needs it
+bool request_chunk(data_t *data, int cid){
+   const scene_t *sc = data->scene;
+   message msg = {.type = MSG_COMPUTE, .data.compute = { .cid = cid, .re = sc->re + (cid % N_RE) * SIZE_C_W * sc->d_re, .im = sc->im + (cid / N_RE) * SIZE_C_H * sc->d_im, .n_re = SIZE_C_W, .n_im = SIZE_C_H}};
+   if (julia_kernel_dd(data->kernel)) {
+      const julia_params_dd p = frame_params(sc);
+      const julia_dd re = julia_coord(p.re, p.d_re, (cid % N_RE) * SIZE_C_W);
+      const julia_dd im = julia_coord(p.im, p.d_im, (cid / N_RE) * SIZE_C_H);
+      msg = (message){.type = MSG_COMPUTE_HP, .data.compute_hp = { .cid = cid, .re = {re.hi, re.lo}, .im = {im.hi, im.lo}, .n_re = SIZE_C_W, .n_im = SIZE_C_H}};
+   }
+   data->stats.chunk_sent[cid] = get_time();
+   data->chunk_bad = false;
+   bool ret = send_message(data, &msg);
+   fsync(data->fd); // sync the data
+   return ret;
+}
+
+// keyboard in the interactive mode, fixed script "g s 1 ... q" in the headless mode
+int next_key(data_t *data){
+   static int i = 0;
+   if (!data->headless) {
+      return getchar();
+   }
+   const char *script = data->cpu ? "c" : (data->hybrid ? "sh" : "s1");
+   static double asked = 0;
+   bool ready = data->cpu; // no module to wait for
+   while (!ready) { // the reference module ignores requests that come too early
+      pthread_mutex_lock(data->mtx);
+      ready = data->version_received;
+      pthread_mutex_unlock(data->mtx);
+      if (!ready && get_time() - asked > 0.5) {
+         asked = get_time();
+         return 'g'; // ask again, every 500 ms
+      } else if (!ready) {
+         usleep(1000);
+      }
+   }
+   if (script[i] != '\0') {
+      return script[i++];
+   }
+   bool done = false;
+   while (!done) {
+      usleep(1000);
+      pthread_mutex_lock(data->mtx);
+      done = data->compute_done || data->abort;
+      pthread_mutex_unlock(data->mtx);
+   }
+   return 'q';
+}
+
+double get_time(void){
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int cmp_double(const void *a, const void *b){
+   double d = *(const double*)a - *(const double*)b;
+   return d < 0 ? -1 : (d > 0);
+}
+
+void print_report(data_t *data){
+   rx_stats *st = &data->stats;
+   const render_stats *pl = &data->pipeline;
+   double lat[NUM_CHUNKS];
+   int n = st->chunks < NUM_CHUNKS ? st->chunks : NUM_CHUNKS;
+   memcpy(lat, st->chunk_latency, n * sizeof(double));
+   qsort(lat, n, sizeof(double), cmp_double);
+   double wall = st->t_end > st->t_start ? st->t_end - st->t_start : 0;
+   double p50 = n ? lat[(n - 1) * 50 / 100] : 0;
+   double p99 = n ? lat[(n - 1) * 99 / 100] : 0;
+   // the kernel that computed the pixels, null if the module did not report it
+   julia_kernel kernel = data->remote_kernel;
+   if (data->cpu) {
+      kernel = data->kernel;
+   } else if (data->hybrid && data->remote_kernel != data->kernel) { // unknown or not the one of ours
+      kernel = JULIA_KERNELS;
+   }
+   char kernel_json[32] = "null";
+   if (kernel < JULIA_KERNELS) {
+      snprintf(kernel_json, sizeof(kernel_json), "\"%s\"", julia_kernel_name(kernel));
+   }
+   fprintf(data->report, "{\"scene\": \"%s\", \"engine\": \"%s\", \"kernel\": %s, \"complete\": %s, \"width\": %d, \"height\": %d, \"n\": %d, "
+         "\"wall_s\": %.6f, \"pixels\": %ld, \"pixels_per_s\": %.1f, \"messages\": %ld, \"messages_per_s\": %.1f, "
+         "\"bytes\": %ld, \"chunks\": %d, \"chunks_local\": %d, \"duplicated\": %d, \"mirrored\": %ld, \"corrupt_frames\": %ld, \"resyncs\": %ld, \"retried\": %d, \"chunk_latency_ms\": {\"p50\": %.3f, \"p99\": %.3f}, "
+         "\"pipeline\": {\"decode_busy\": %.4f, \"colour_workers\": %d, \"colour_busy\": %.4f, \"colour_queue\": {\"mean\": %.2f, \"max\": %d, \"stalls\": %ld}, "
+         "\"present_busy\": %.4f, \"present_queue\": {\"mean\": %.2f, \"max\": %d, \"stalls\": %ld}, \"presents\": %ld}",
+         data->scene->name, data->cpu ? "cpu" : (data->hybrid ? "hybrid" : (data->replay_file ? "replay" : "module")), kernel_json, data->compute_done ? "true" : "false", W, H, data->scene->n,
+         wall, st->pixels, wall > 0 ? st->pixels / wall : 0, st->messages, wall > 0 ? st->messages / wall : 0,
+         st->bytes, st->chunks, st->local_chunks, st->duplicated, st->mirrored, data->rx.corrupt, data->rx.resyncs, st->retried, p50 * 1e3, p99 * 1e3,
+         pl->wall_s > 0 ? data->decode_ns * 1e-9 / pl->wall_s : 0, pl->workers, pl->colour_busy, pl->colour_queue, pl->colour_queue_max, pl->colour_stalls,
+         pl->present_busy, pl->present_queue, pl->present_queue_max, pl->present_stalls, pl->presents);
+   const cpu_stats *lc = &st->local;
+   if (lc->threads > 0) { // the cost model against the measured work of every chunk
+      fprintf(data->report, ", \"schedule\": {\"threads\": %d, \"prepass_ms\": %.3f, \"work_s\": %.6f, \"ideal_s\": %.6f, \"rows_helped\": %ld, \"cost_corr\": %.3f, \"chunk_cost\": [",
+            lc->threads, lc->prepass_s * 1e3, lc->work_s, lc->work_s / lc->threads, lc->rows_helped, st->cost_corr);
+      for (int i = 0; i < NUM_CHUNKS; ++i) {
+         fprintf(data->report, "%s%.0f", i ? ", " : "", st->chunk_cost[i]);
+      }
+      fprintf(data->report, "], \"chunk_work_ms\": [");
+      for (int i = 0; i < NUM_CHUNKS; ++i) {
+         fprintf(data->report, "%s%.3f", i ? ", " : "", st->chunk_work[i] * 1e3);
+      }
+      fprintf(data->report, "]}");
+   }
+   fprintf(data->report, "}\n");
+   fflush(data->report);
+}
+
+// the local workers of the last frame: their work against the wall time of the
+// frame (the ideal is the work spread evenly over them) and the cost model
+void print_schedule(data_t *data, FILE *out){
+   const rx_stats *st = &data->stats;
+   const cpu_stats *lc = &st->local;
+   if (lc->threads == 0) {
+      return;
+   }
+   fprintf(out, "\033[1;34mSCHEDULE\033[0m: %d workers, %.3f s of work, %.3f s per worker in a %.3f s frame, %ld rows split off, cost model r = %.3f (pre-pass %.2f ms)\r\n",
+         lc->threads, lc->work_s, lc->work_s / lc->threads, st->t_end - st->t_start, lc->rows_helped, st->cost_corr, lc->prepass_s * 1e3);
+}
+
+// occupancy of the receive stages: the share of the time each of them worked
+// and the jobs found waiting in its ring when the next one was queued
+void print_pipeline(data_t *data, FILE *out){
+   const render_stats *pl = &data->pipeline;
+   fprintf(out, "\033[1;34mPIPELINE\033[0m: decode %.1f %% busy, colour %d x %.1f %% busy (queue %.2f, max %d of %d, %ld stalls), present %.1f %% busy (queue %.2f, max %d of %d, %ld stalls), %ld frames in %.3f s\r\n",
+         pl->wall_s > 0 ? data->decode_ns * 1e-7 / pl->wall_s : 0, pl->workers, pl->colour_busy * 100, pl->colour_queue, pl->colour_queue_max, RING_SLOTS, pl->colour_stalls,
+         pl->present_busy * 100, pl->present_queue, pl->present_queue_max, RING_SLOTS, pl->present_stalls, pl->presents, pl->wall_s);
+}
+
+// the histograms of the module from MSG_STATS, kept for print_stages(),
+// and the kernel it computed with for print_report()
+bool remote_stats(data_t *data, const msg_stats *m, const uint8_t *payload){
+   data->remote_kernel = m->kernel < JULIA_KERNELS ? m->kernel : JULIA_KERNELS;
+   if (data->remote_histo == NULL && (data->remote_histo = malloc(sizeof(histo))) == NULL) {
+      return false;
+   }
+   return histo_unpack(payload, m->len, data->remote_histo);
+}
+
+// the stage latencies of both processes as text, and as JSON into --stages
+void print_stages(data_t *data){
+   histo *h = malloc(sizeof(histo));
+   if (h == NULL) {
+      return;
+   }
+   FILE *out = data->headless ? stderr : stdout; // stdout of --headless is the JSON report
+   histo_collect(h);
+   histo_print(h, "prgsem-main", out);
+   if (data->remote_histo) {
+      histo_print(data->remote_histo, "module", out);
+   }
+   FILE *f = data->stages_file ? fopen(data->stages_file, "w") : NULL;
+   if (data->stages_file && f == NULL) {
+      fprintf(stderr, "\033[1;31mERROR\033[0m: Unable to open the file %s\r\n", data->stages_file);
+   }
+   if (f) {
+      fprintf(f, "[");
+      histo_json(h, "prgsem-main", f);
+      if (data->remote_histo) {
+         fprintf(f, ",");
+         histo_json(data->remote_histo, "module", f);
+      }
+      fprintf(f, "]\n");
+      fclose(f);
+   }
+   free(h);
+}
+
 bool send_message(data_t *data, message *msg){
    uint8_t msg_buf[sizeof(message)];
    int size;
@@ -450,32 +1280,141 @@ bool send_message(data_t *data, message *msg){
    fill_message_buf(msg, msg_buf,sizeof(message), &size);
    //printf("filled");
    pthread_mutex_lock(data->mtx);
-   int ret = write(data->fd, msg_buf, size);
+   bool ret = io_write_all(data->fd, msg_buf, size);
+   capture_add(data->capture, CAPTURE_WRITE, msg_buf, size);
    pthread_mutex_unlock(data->mtx);
-   return size == ret;
+   return ret;
 }
 
-message *buffer_parse(data_t *data, int message_type){
-    uint8_t c;
-    int len = 0;
-    uint8_t msg_buf[sizeof(message)];
-    int i = 0;
-    get_message_size(message_type, &len);
-    msg_buf[i++] = message_type; // add the first byte 
-    while((i < len)){
-        io_getc_timeout(data->rd, 0, &c);
-        msg_buf[i++] = c;
-    }
-    message *msg = malloc(sizeof(message));
-    msg->type = message_type;
-    get_message_size(message_type, &len);
-    if(!parse_message_buf(msg_buf, len, msg)){
-        fprintf(stderr, "\033[1;31mERROR\033[0m: Unable to parse the message\n");
-        free(msg);
-        exit(1);
-    } 
-    return msg;
+// the payload following a plain message, read at once from the blocking pipe
+bool read_payload(data_t *data, uint8_t *buf, int len){
+   int i = 0;
+   struct pollfd pfd = { .fd = data->rd, .events = POLLIN };
+   while (i < len) {
+      if (poll(&pfd, 1, PLAIN_TIMEOUT_MS) <= 0) {
+         return false;
+      }
+      ssize_t r = read(data->rd, buf + i, len - i);
+      if (r < 0 && errno == EINTR) {
+         continue;
+      }
+      if (r <= 0) {
+         return false;
+      }
+      capture_add(data->capture, CAPTURE_READ, buf + i, r);
+      i += r;
+   }
+   data->stats.bytes += len;
+   return true;
+}
 
+// the next message of the module, false if none is ready; a frame is checked
+// whole and after a corrupted one the stream resynchronises on the next sync
+// byte; the chunk in flight is then marked to be requested again
+bool read_message(data_t *data, message *msg, const uint8_t **payload){
+   static uint8_t plain[sizeof(message) + FRAME_MAX_BODY];
+   frame_reader *rx = &data->rx;
+   const long lost = rx->corrupt + rx->resyncs;
+   int len = 0;
+   const uint8_t *body = data->framed ? frame_next(rx, &len) : NULL;
+   uint8_t c;
+   if (!data->framed && io_getc_timeout(data->rd, 0, &c) == 1) {
+      capture_add(data->capture, CAPTURE_READ, &c, 1);
+      data->stats.bytes += 1;
+      data->t_rx = get_time();
+      // ./module starts by a frame and the reference module by a plain message,
+      // a later 0xa5 (e.g., a checksum after a desync) is only garbage
+      const bool first = !data->framing_known;
+      data->framing_known = true;
+      if (first && c == FRAME_SYNC) { // only frames come from now on
+         data->framed = true;
+         rx->buf[rx->len++] = c;
+      } else {
+         const uint64_t s0 = TRACE_BEGIN();
+         const uint64_t t0 = HISTO_NOW();
+         body = read_plain(data, c, plain, &len);
+         HISTO_ADD(STAGE_READ, HISTO_NOW() - t0);
+         TRACE_END("read", s0, len);
+      }
+   }
+   struct pollfd pfd = { .fd = data->rd, .events = POLLIN };
+   if (!body && data->framed && poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN)) {
+      const uint64_t s0 = TRACE_BEGIN();
+      const uint64_t t0 = HISTO_NOW();
+      ssize_t r = read(data->rd, rx->buf + rx->len, sizeof(rx->buf) - rx->len);
+      HISTO_ADD(STAGE_READ, HISTO_NOW() - t0);
+      TRACE_END("batch read", s0, r);
+      if (r > 0) {
+         capture_add(data->capture, CAPTURE_READ, rx->buf + rx->len, r);
+         rx->len += r;
+         data->stats.bytes += r;
+         data->t_rx = get_time();
+         body = frame_next(rx, &len);
+      }
+   }
+   int size;
+   const uint64_t t0 = HISTO_NOW();
+   bool ret = body && get_message_size(body[0], &size) && size <= len && parse_message_buf(body, size, msg);
+   if (body) {
+      HISTO_ADD(STAGE_DECODE, HISTO_NOW() - t0);
+   }
+   if (ret) {
+      data->stats.messages += 1;
+      *payload = body + size;
+   } else if (body) { // the frame crc is fine, yet the message is not
+      rx->corrupt += 1;
+   }
+   if (rx->corrupt + rx->resyncs != lost) {
+      data->chunk_bad = true;
+   }
+   return ret;
+}
+
+// the plain message of the reference module that starts by the type byte,
+// read into buf; NULL if the byte does not start a message or the rest does not come
+const uint8_t *read_plain(data_t *data, uint8_t type, uint8_t *buf, int *len){
+   frame_reader *rx = &data->rx;
+   if (!get_message_size(type, len)) { // garbage, the next byte may start a message
+      rx->resyncs += !rx->lost;
+      rx->lost = true;
+      return NULL;
+   }
+   buf[0] = type;
+   int i = 1;
+   while (i < *len && io_getc_timeout(data->rd, PLAIN_TIMEOUT_MS, &buf[i]) == 1) {
+      i++;
+   }
+   capture_add(data->capture, CAPTURE_READ, buf + 1, i - 1);
+   data->stats.bytes += i - 1;
+   int payload = 0;
+   if (i == *len && (payload = get_payload_size(buf)) > 0) {
+      if (!read_payload(data, buf + i, payload)) {
+         i = 0;
+      }
+   }
+   if (i < *len) {
+      rx->corrupt += 1;
+      rx->resyncs += !rx->lost;
+      rx->lost = true;
+      return NULL;
+   }
+   rx->lost = false;
+   *len += payload;
+   return buf;
+}
+
+// request the chunk in flight again after its data was lost, called with data->mtx locked
+void retry_chunk(data_t *data){
+   const int cid = data->remote_cid >= 0 ? data->remote_cid : (data->compute_used && !data->frame_active ? data->cid : -1);
+   data->chunk_bad = false;
+   if (cid < 0 || data->abort) {
+      return;
+   }
+   printf("\033[1;33mWARNING\033[0m: Data of chunk %d lost, requested again\r\n", cid);
+   data->stats.retried += 1;
+   pthread_mutex_unlock(data->mtx);
+   request_chunk(data, cid);
+   pthread_mutex_lock(data->mtx);
 }
 
 
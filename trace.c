@@ -0,0 +1,140 @@
+/*
+ * Filename: trace.c
+ * Date:     2026/10/19
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+typedef struct {
+   uint64_t t0;      // ns of histo_now()
+   uint64_t dur;     // ns
+   const char *name;
+   int32_t arg;
+   int32_t tid;
+} trace_event;
+
+typedef struct trace_node {
+   trace_event *ring;       // TRACE_RING spans, written by the owner thread only
+   uint64_t head;           // spans recorded so far (atomic)
+   const char *name;        // thread name
+   int32_t tid;             // owner, the node is taken over when its thread exits
+   bool free;               // (atomic)
+   struct trace_node *next; // immutable once the node is in the list
+} trace_node;
+
+bool trace_on;
+
+static const char *trace_file;
+static const char *trace_process;
+static trace_node *nodes;     // pushed by CAS, never removed
+static __thread trace_node *mine;
+static pthread_key_t key;     // releases the node when its thread exits
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+// - function -----------------------------------------------------------------
+static void node_release(void *d)
+{
+   __atomic_store_n(&((trace_node*)d)->free, true, __ATOMIC_RELEASE);
+}
+
+// - function -----------------------------------------------------------------
+static void key_init(void)
+{
+   pthread_key_create(&key, node_release);
+}
+
+// - function -----------------------------------------------------------------
+static trace_node *node_take(void)
+{
+   pthread_once(&once, key_init);
+   trace_node *n = __atomic_load_n(&nodes, __ATOMIC_ACQUIRE);
+   for (; n; n = n->next) { // the cpu workers come and go with every frame
+      bool f = true;
+      if (__atomic_compare_exchange_n(&n->free, &f, false, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+         break;
+      }
+   }
+   if (n == NULL) {
+      if ((n = calloc(1, sizeof(trace_node))) == NULL || (n->ring = malloc(TRACE_RING * sizeof(trace_event))) == NULL) {
+         free(n);
+         return NULL;
+      }
+      n->next = __atomic_load_n(&nodes, __ATOMIC_RELAXED);
+      while (!__atomic_compare_exchange_n(&nodes, &n->next, n, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+   }
+   n->name = "thread";
+   n->tid = syscall(SYS_gettid);
+   pthread_setspecific(key, n);
+   return n;
+}
+
+// - function -----------------------------------------------------------------
+void trace_open(const char *file, const char *process)
+{
+   trace_file = file;
+   trace_process = process;
+   trace_on = true;
+}
+
+// - function -----------------------------------------------------------------
+void trace_thread(const char *name)
+{
+   if (trace_on && (mine || (mine = node_take()))) {
+      mine->name = name;
+   }
+}
+
+// - function -----------------------------------------------------------------
+void trace_span(const char *name, uint64_t t0, int arg)
+{
+   trace_node *n = mine;
+   if (n == NULL && (n = mine = node_take()) == NULL) {
+      return;
+   }
+   const uint64_t h = n->head;
+   n->ring[h % TRACE_RING] = (trace_event){ t0, histo_now() - t0, name, arg, n->tid };
+   __atomic_store_n(&n->head, h + 1, __ATOMIC_RELEASE);
+}
+
+// - function -----------------------------------------------------------------
+bool trace_close(void)
+{
+   if (!trace_on) {
+      return true;
+   }
+   FILE *f = fopen(trace_file, "w");
+   if (f == NULL) {
+      return false;
+   }
+   const int pid = getpid();
+   fprintf(f, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+   fprintf(f, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, \"args\": {\"name\": \"%s\"}}", pid, pid, trace_process);
+   for (trace_node *n = __atomic_load_n(&nodes, __ATOMIC_ACQUIRE); n; n = n->next) {
+      const uint64_t head = __atomic_load_n(&n->head, __ATOMIC_ACQUIRE);
+      int32_t tid = n->tid;
+      fprintf(f, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, \"args\": {\"name\": \"%s\"}}", pid, tid, n->name);
+      for (uint64_t i = head > TRACE_RING ? head - TRACE_RING : 0; i < head; ++i) {
+         const trace_event *e = &n->ring[i % TRACE_RING];
+         if (e->tid != tid) { // a reused node holds the spans of several threads
+            tid = e->tid;
+            fprintf(f, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, \"tid\": %d, \"args\": {\"name\": \"%s\"}}", pid, tid, n->name);
+         }
+         fprintf(f, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": %d, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f", e->name, pid, e->tid, e->t0 * 1e-3, e->dur * 1e-3);
+         if (e->arg >= 0) {
+            fprintf(f, ", \"args\": {\"id\": %d}", e->arg);
+         }
+         fprintf(f, "}");
+      }
+   }
+   fprintf(f, "\n]}\n");
+   return fclose(f) == 0;
+}
+
+/* end of trace.c */
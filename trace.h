@@ -0,0 +1,58 @@
+/*
+ * Filename: trace.h
+ * Date:     2026/10/19
+ *
+ * Opt-in span tracing in the Chrome trace-event format (chrome://tracing,
+ * ui.perfetto.dev). Every thread records into its own ring buffer; the spans
+ * are stamped by the CLOCK_MONOTONIC of histo_now(), which all processes on
+ * the host share, so the files of prgsem-main and ./module line up.
+ */
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "histo.h"
+
+#define TRACE_RING (1 << 16) // the last spans kept per thread
+
+extern bool trace_on; // set once by trace_open() before the threads start
+
+#define TRACE_BEGIN() (trace_on ? histo_now() : 0)
+#define TRACE_END(name, t0, arg) do { if (t0) { trace_span((name), (t0), (arg)); } } while (0)
+
+/// ----------------------------------------------------------------------------
+/// @brief trace_open -- enable the tracing, the spans are written to file by
+/// trace_close()
+///
+/// @param process -- name of the process in the trace
+/// ----------------------------------------------------------------------------
+void trace_open(const char *file, const char *process);
+
+/// ----------------------------------------------------------------------------
+/// @brief trace_thread -- name of the calling thread in the trace
+/// ----------------------------------------------------------------------------
+void trace_thread(const char *name);
+
+/// ----------------------------------------------------------------------------
+/// @brief trace_span -- record the span from t0 to now into the ring of the
+/// calling thread, the oldest span is overwritten when the ring is full
+///
+/// @param name   -- static string
+/// @param arg    -- shown as args.id (chunk id, bytes), -1 for none
+/// ----------------------------------------------------------------------------
+void trace_span(const char *name, uint64_t t0, int arg);
+
+/// ----------------------------------------------------------------------------
+/// @brief trace_close -- write the spans of all threads as one JSON file
+///
+/// The threads may still record, their newest spans can be missing.
+/// @return false if the file cannot be written, true if tracing is off
+/// ----------------------------------------------------------------------------
+bool trace_close(void);
+
+#endif
+
+/* end of trace.h */
@@ -0,0 +1,334 @@
+/*
+ * Filename: uring.c
+ * Date:     2026/10/19
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "uring.h"
+
+#define URING_ENTRIES 32 // at least the writes of a batch, see uring_write_batch()
+#define URING_MAX_FIXED 8
+
+typedef struct {
+   int fd;
+   unsigned *sq_head;
+   unsigned *sq_tail;
+   unsigned *sq_mask;
+   unsigned *sq_array;
+   unsigned *cq_head;
+   unsigned *cq_tail;
+   unsigned *cq_mask;
+   struct io_uring_sqe *sqes;
+   struct io_uring_cqe *cqes;
+   void *sq_ptr;
+   size_t sq_size;
+   void *cq_ptr;   // sq_ptr with IORING_FEAT_SINGLE_MMAP
+   size_t cq_size;
+   size_t sqes_size;
+   struct iovec fixed[URING_MAX_FIXED]; // registered buffers
+   int n_fixed;
+   bool poll_first; // the reads refused RWF_NOWAIT (a fifo on older kernels)
+} uring_t;
+
+static pthread_key_t key;
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+static __thread uring_t *ring;
+static __thread bool failed; // the ring of the thread could not be set up
+
+// - function -----------------------------------------------------------------
+static int sys_setup(unsigned entries, struct io_uring_params *p)
+{
+   return syscall(__NR_io_uring_setup, entries, p);
+}
+
+// - function -----------------------------------------------------------------
+static int sys_enter(int fd, unsigned submit, unsigned complete, unsigned flags)
+{
+   return syscall(__NR_io_uring_enter, fd, submit, complete, flags, NULL, 0);
+}
+
+// - function -----------------------------------------------------------------
+static int sys_register(int fd, unsigned op, const void *arg, unsigned n)
+{
+   return syscall(__NR_io_uring_register, fd, op, arg, n);
+}
+
+// - function -----------------------------------------------------------------
+static void ring_free(void *d)
+{
+   uring_t *r = (uring_t*)d;
+   if (r->sqes) {
+      munmap(r->sqes, r->sqes_size);
+   }
+   if (r->cq_ptr && r->cq_ptr != r->sq_ptr) {
+      munmap(r->cq_ptr, r->cq_size);
+   }
+   if (r->sq_ptr) {
+      munmap(r->sq_ptr, r->sq_size);
+   }
+   close(r->fd);
+   free(r);
+}
+
+// - function -----------------------------------------------------------------
+static void make_key(void)
+{
+   pthread_key_create(&key, ring_free); // the ring of a thread is closed when it exits
+}
+
+// - function -----------------------------------------------------------------
+static uring_t *ring_open(void)
+{
+   struct io_uring_params p;
+   memset(&p, 0, sizeof(p));
+   uring_t *r = calloc(1, sizeof(uring_t));
+   if (r == NULL) {
+      return NULL;
+   }
+   if ((r->fd = sys_setup(URING_ENTRIES, &p)) < 0) {
+      free(r);
+      return NULL;
+   }
+   r->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+   r->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+   if (p.features & IORING_FEAT_SINGLE_MMAP) {
+      r->sq_size = r->cq_size = r->sq_size > r->cq_size ? r->sq_size : r->cq_size;
+   }
+   r->sq_ptr = mmap(NULL, r->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+   if (r->sq_ptr == MAP_FAILED) {
+      r->sq_ptr = NULL;
+      ring_free(r);
+      return NULL;
+   }
+   r->cq_ptr = r->sq_ptr;
+   if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+      r->cq_ptr = mmap(NULL, r->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+      if (r->cq_ptr == MAP_FAILED) {
+         r->cq_ptr = NULL;
+         ring_free(r);
+         return NULL;
+      }
+   }
+   r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+   r->sqes = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+   if (r->sqes == MAP_FAILED) {
+      r->sqes = NULL;
+      ring_free(r);
+      return NULL;
+   }
+   uint8_t *sq = r->sq_ptr;
+   uint8_t *cq = r->cq_ptr;
+   r->sq_head = (unsigned*)(sq + p.sq_off.head);
+   r->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+   r->sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+   r->sq_array = (unsigned*)(sq + p.sq_off.array);
+   r->cq_head = (unsigned*)(cq + p.cq_off.head);
+   r->cq_tail = (unsigned*)(cq + p.cq_off.tail);
+   r->cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+   r->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+   return r;
+}
+
+// - function -----------------------------------------------------------------
+// the ring of the calling thread, NULL if it cannot have one
+static uring_t *get_ring(void)
+{
+   if (ring == NULL && !failed) {
+      pthread_once(&once, make_key);
+      ring = ring_open();
+      failed = ring == NULL;
+      if (ring) {
+         pthread_setspecific(key, ring);
+      }
+   }
+   return ring;
+}
+
+// - function -----------------------------------------------------------------
+// the next submission entry, cleared; nothing is in flight, so there is one
+static struct io_uring_sqe *get_sqe(uring_t *r, unsigned *n)
+{
+   const unsigned tail = *r->sq_tail + *n;
+   const unsigned i = tail & *r->sq_mask;
+   struct io_uring_sqe *sqe = &r->sqes[i];
+   memset(sqe, 0, sizeof(*sqe));
+   r->sq_array[i] = i;
+   *n += 1;
+   return sqe;
+}
+
+// - function -----------------------------------------------------------------
+// submit the n entries of get_sqe() and wait for their n completions, their
+// results into res by user_data; false if the ring itself fails
+static bool submit_wait(uring_t *r, unsigned n, int *res)
+{
+   __atomic_store_n(r->sq_tail, *r->sq_tail + n, __ATOMIC_RELEASE);
+   unsigned submitted = 0;
+   unsigned reaped = 0;
+   while (reaped < n) {
+      const int ret = sys_enter(r->fd, n - submitted, n - reaped, IORING_ENTER_GETEVENTS);
+      if (ret < 0 && errno != EINTR) {
+         return false;
+      }
+      submitted += ret > 0 ? ret : 0;
+      unsigned head = *r->cq_head;
+      while (head != __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) {
+         const struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+         if (cqe->user_data < n) {
+            res[cqe->user_data] = cqe->res;
+         }
+         head += 1;
+         reaped += 1;
+      }
+      __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+   }
+   return true;
+}
+
+// - function -----------------------------------------------------------------
+bool uring_probe(void)
+{
+   const int ops[] = { IORING_OP_READ, IORING_OP_WRITE, IORING_OP_WRITE_FIXED, IORING_OP_LINK_TIMEOUT };
+   uring_t *r = get_ring();
+   if (r == NULL) {
+      return false;
+   }
+   const size_t size = sizeof(struct io_uring_probe) + IORING_OP_LAST * sizeof(struct io_uring_probe_op);
+   struct io_uring_probe *probe = calloc(1, size);
+   bool ok = probe && sys_register(r->fd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) == 0;
+   for (int i = 0; ok && i < sizeof(ops) / sizeof(ops[0]); ++i) {
+      ok = ops[i] <= probe->last_op && (probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED);
+   }
+   free(probe);
+   return ok;
+}
+
+// - function -----------------------------------------------------------------
+int uring_getc_timeout(int fd, int timeout_ms, unsigned char *c)
+{
+   uring_t *r = get_ring();
+   if (r == NULL) {
+      return URING_NONE;
+   }
+   if (timeout_ms == 0 && r->poll_first) {
+      struct pollfd ufd = { .fd = fd, .events = POLLIN };
+      const int ret = poll(&ufd, 1, 0);
+      if (ret <= 0) {
+         return ret;
+      }
+      timeout_ms = -1; // a byte is there, the read does not block
+   }
+   struct __kernel_timespec ts = { .tv_sec = timeout_ms / 1000, .tv_nsec = (timeout_ms % 1000) * 1000000L };
+   int res[2] = { 0, 0 };
+   unsigned n = 0;
+   struct io_uring_sqe *sqe = get_sqe(r, &n);
+   sqe->opcode = IORING_OP_READ;
+   sqe->fd = fd;
+   sqe->addr = (uintptr_t)c;
+   sqe->len = 1;
+   sqe->off = -1; // the file position, a pipe has none
+   sqe->user_data = 0;
+   if (timeout_ms == 0) {
+      sqe->rw_flags = RWF_NOWAIT; // only a byte already there
+   } else if (timeout_ms > 0) {
+      sqe->flags = IOSQE_IO_LINK;
+      sqe = get_sqe(r, &n);
+      sqe->opcode = IORING_OP_LINK_TIMEOUT;
+      sqe->addr = (uintptr_t)&ts;
+      sqe->len = 1;
+      sqe->user_data = 1;
+   }
+   if (!submit_wait(r, n, res)) {
+      return -1;
+   }
+   if (res[0] == 1) {
+      return 1;
+   }
+   if (res[0] == -EOPNOTSUPP && timeout_ms == 0 && !r->poll_first) {
+      r->poll_first = true;
+      return uring_getc_timeout(fd, 0, c);
+   }
+   // nothing in time (cancelled by the timeout), none ready or the end of the pipe
+   return res[0] == 0 || res[0] == -EAGAIN || res[0] == -ECANCELED || res[0] == -EINTR ? 0 : -1;
+}
+
+// - function -----------------------------------------------------------------
+int uring_write(int fd, const void *buf, int size)
+{
+   struct iovec iov = { .iov_base = (void*)buf, .iov_len = size };
+   int done = 0;
+   const int ret = uring_write_batch(fd, &iov, 1, &done);
+   return ret == URING_NONE ? URING_NONE : (ret ? done : -1);
+}
+
+// - function -----------------------------------------------------------------
+int uring_write_batch(int fd, const struct iovec *iov, int n, int *done)
+{
+   uring_t *r = get_ring();
+   if (r == NULL) {
+      return URING_NONE;
+   }
+   int res[URING_ENTRIES];
+   for (int first = 0; first < n; first += URING_ENTRIES) { // more than a ring in parts
+      const int m = n - first < URING_ENTRIES ? n - first : URING_ENTRIES;
+      unsigned k = 0;
+      for (int i = 0; i < m; ++i) {
+         const struct iovec *v = &iov[first + i];
+         struct io_uring_sqe *sqe = get_sqe(r, &k);
+         sqe->opcode = IORING_OP_WRITE;
+         sqe->fd = fd;
+         sqe->addr = (uintptr_t)v->iov_base;
+         sqe->len = v->iov_len;
+         sqe->off = -1;
+         sqe->user_data = i;
+         sqe->flags = i + 1 < m ? IOSQE_IO_LINK : 0; // in order, a short write cancels the rest
+         for (int j = 0; j < r->n_fixed; ++j) {
+            const uint8_t *base = r->fixed[j].iov_base;
+            if ((const uint8_t*)v->iov_base >= base && (const uint8_t*)v->iov_base + v->iov_len <= base + r->fixed[j].iov_len) {
+               sqe->opcode = IORING_OP_WRITE_FIXED;
+               sqe->buf_index = j;
+               break;
+            }
+         }
+      }
+      if (!submit_wait(r, m, res)) {
+         return 0;
+      }
+      for (int i = 0; i < m; ++i) {
+         if (res[i] < 0 && res[i] != -ECANCELED && res[i] != -EINTR && res[i] != -EAGAIN) {
+            errno = -res[i];
+            return 0;
+         }
+         done[first + i] = res[i] > 0 ? res[i] : 0;
+      }
+   }
+   return 1;
+}
+
+// - function -----------------------------------------------------------------
+int uring_register(const struct iovec *iov, int n)
+{
+   uring_t *r = get_ring();
+   if (r == NULL) {
+      return URING_NONE;
+   }
+   if (n > URING_MAX_FIXED || sys_register(r->fd, IORING_REGISTER_BUFFERS, iov, n) != 0) {
+      return 0;
+   }
+   memcpy(r->fixed, iov, n * sizeof(struct iovec));
+   r->n_fixed = n;
+   return 1;
+}
+
+/* end of uring.c */
@@ -0,0 +1,62 @@
+/*
+ * Filename: uring.h
+ * Date:     2026/10/19
+ *
+ * io_uring backend of prg_io_nonblock, by the raw system calls (no liburing).
+ * Every thread gets a small ring of its own on its first call, so the rings
+ * are never shared and need no lock; a call submits its operations and reaps
+ * all their completions by a single io_uring_enter(), nothing stays in flight
+ * between the calls. The functions return URING_NONE when the ring of the
+ * thread cannot be set up, the caller then does the same by the plain calls.
+ */
+
+#ifndef __URING_H__
+#define __URING_H__
+
+#include <stdbool.h>
+
+#include <sys/uio.h>
+
+#define URING_NONE -2 // no ring in this thread, use read()/write()
+
+/// ----------------------------------------------------------------------------
+/// @brief uring_probe -- the kernel supports the operations of the backend
+/// (read, write, fixed write, linked timeout) and io_uring is not disabled
+/// ----------------------------------------------------------------------------
+bool uring_probe(void);
+
+/// ----------------------------------------------------------------------------
+/// @brief uring_getc_timeout -- one byte of fd within timeout_ms (0 does not
+/// wait, < 0 waits for ever), the read and its linked timeout in one submission
+///
+/// @return -1 on error, 0 no byte ready within the timeout, 1 one byte read
+/// ----------------------------------------------------------------------------
+int uring_getc_timeout(int fd, int timeout_ms, unsigned char *c);
+
+/// ----------------------------------------------------------------------------
+/// @brief uring_write -- one write(), its result
+/// ----------------------------------------------------------------------------
+int uring_write(int fd, const void *buf, int size);
+
+/// ----------------------------------------------------------------------------
+/// @brief uring_write_batch -- the n buffers one after the other, linked so the
+/// kernel keeps their order, by one submission; a buffer inside a registered
+/// one is written by IORING_OP_WRITE_FIXED
+///
+/// @param done -- bytes of every buffer written, the caller finishes the short
+///                and the cancelled ones
+/// @return 1, 0 on an error other than a short write (errno is set)
+/// ----------------------------------------------------------------------------
+int uring_write_batch(int fd, const struct iovec *iov, int n, int *done);
+
+/// ----------------------------------------------------------------------------
+/// @brief uring_register -- pin n buffers for uring_write_batch() of the
+/// calling thread, they must stay allocated while it writes
+///
+/// @return 1, 0 if the kernel refuses them (e.g., RLIMIT_MEMLOCK)
+/// ----------------------------------------------------------------------------
+int uring_register(const struct iovec *iov, int n);
+
+#endif
+
+/* end of uring.h */
@@ -0,0 +1,254 @@
+/*
+ * Filename: video_sink.c
+ * Date:     2026/10/19
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include "prg_io_nonblock.h"
+#include "video_sink.h"
+
+#define SINK_SLOTS 2   // double buffering - at most two frames wait for the encoder
+#define SINK_LANES 4
+#define SINK_BLOCK (2 * SINK_LANES)  // columns of a row pair converted per vector step
+
+typedef int32_t v4si __attribute__((vector_size(16))); // one SSE2/NEON register
+
+struct video_sink {
+   int fd;
+   sink_format fmt;
+   int w;
+   int h;
+   size_t frame_size;    // rgb bytes of one frame
+   unsigned char *slot[SINK_SLOTS];
+   unsigned char *yuv;   // encoder scratch (planar 4:2:0)
+   int head;             // next slot to fill
+   int tail;             // next slot to encode
+   int full;             // number of slots waiting for the encoder
+   bool quit;
+   bool failed;
+   pthread_t thread;
+   pthread_mutex_t mtx;
+   pthread_cond_t cond_full;
+   pthread_cond_t cond_free;
+};
+
+static void* sink_thread(void *d);
+
+// - function -----------------------------------------------------------------
+video_sink *sink_open(const char *fname, sink_format fmt, int w, int h, int fps)
+{
+   if (fmt == SINK_Y4M && ((w % 2) || (h % 2))) {
+      fprintf(stderr, "\033[1;31mERROR\033[0m: Y4M sink needs even frame size\r\n");
+      return NULL;
+   }
+   video_sink *sink = calloc(1, sizeof(video_sink));
+   if (sink == NULL) {
+      return NULL;
+   }
+   if (strcmp(fname, "-") == 0) {
+      // the stream takes over stdout, the console messages continue on stderr
+      sink->fd = dup(STDOUT_FILENO);
+      dup2(STDERR_FILENO, STDOUT_FILENO);
+   } else {
+      sink->fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   }
+   if (sink->fd == -1) {
+      fprintf(stderr, "\033[1;31mERROR\033[0m: Unable to open the file %s\r\n", fname);
+      free(sink);
+      return NULL;
+   }
+   sink->fmt = fmt;
+   sink->w = w;
+   sink->h = h;
+   sink->frame_size = (size_t)w * h * 3;
+   for (int i = 0; i < SINK_SLOTS; ++i) {
+      sink->slot[i] = malloc(sink->frame_size);
+   }
+   sink->yuv = fmt == SINK_Y4M ? malloc((size_t)w * h * 3 / 2) : NULL;
+   if (!sink->slot[0] || !sink->slot[1] || (fmt == SINK_Y4M && !sink->yuv)) {
+      fprintf(stderr, "\033[1;31mERROR\033[0m: Unable to allocate sink buffers\r\n");
+      close(sink->fd);
+      free(sink->slot[0]);
+      free(sink->slot[1]);
+      free(sink->yuv);
+      free(sink);
+      return NULL;
+   }
+   if (fmt == SINK_Y4M) {
+      char header[64];
+      int len = snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", w, h, fps);
+      sink->failed = !io_write_all(sink->fd, header, len);
+   }
+   pthread_mutex_init(&sink->mtx, NULL);
+   pthread_cond_init(&sink->cond_full, NULL);
+   pthread_cond_init(&sink->cond_free, NULL);
+   pthread_create(&sink->thread, NULL, sink_thread, sink);
+   return sink;
+}
+
+// - function -----------------------------------------------------------------
+bool sink_push(video_sink *sink, const unsigned char *rgb)
+{
+   pthread_mutex_lock(&sink->mtx);
+   while (sink->full == SINK_SLOTS && !sink->failed) { // backpressure
+      pthread_cond_wait(&sink->cond_free, &sink->mtx);
+   }
+   bool ret = !sink->failed;
+   int i = sink->head;
+   pthread_mutex_unlock(&sink->mtx);
+   if (ret) {
+      // the slot is not touched by the encoder until it is marked full
+      memcpy(sink->slot[i], rgb, sink->frame_size);
+      pthread_mutex_lock(&sink->mtx);
+      sink->head = (sink->head + 1) % SINK_SLOTS;
+      sink->full += 1;
+      pthread_cond_signal(&sink->cond_full);
+      pthread_mutex_unlock(&sink->mtx);
+   }
+   return ret;
+}
+
+// - function -----------------------------------------------------------------
+void sink_close(video_sink *sink)
+{
+   if (sink == NULL) {
+      return;
+   }
+   pthread_mutex_lock(&sink->mtx);
+   sink->quit = true;
+   pthread_cond_signal(&sink->cond_full);
+   pthread_mutex_unlock(&sink->mtx);
+   pthread_join(sink->thread, NULL);
+   close(sink->fd);
+   pthread_mutex_destroy(&sink->mtx);
+   pthread_cond_destroy(&sink->cond_full);
+   pthread_cond_destroy(&sink->cond_free);
+   free(sink->slot[0]);
+   free(sink->slot[1]);
+   free(sink->yuv);
+   free(sink);
+}
+
+// - function -----------------------------------------------------------------
+static void* sink_thread(void *d)
+{
+   video_sink *sink = (video_sink*)d;
+   const size_t luma = (size_t)sink->w * sink->h;
+   pthread_mutex_lock(&sink->mtx);
+   while (true) {
+      while (sink->full == 0 && !sink->quit) {
+         pthread_cond_wait(&sink->cond_full, &sink->mtx);
+      }
+      if (sink->full == 0) { // quit and everything flushed
+         break;
+      }
+      const unsigned char *rgb = sink->slot[sink->tail];
+      bool failed = sink->failed;
+      pthread_mutex_unlock(&sink->mtx);
+
+      bool ok = true;
+      if (!failed && sink->fmt == SINK_Y4M) {
+         sink_rgb_to_yuv420(rgb, sink->w, sink->h, sink->yuv, sink->yuv + luma, sink->yuv + luma + luma / 4);
+         const struct iovec iov[2] = { { "FRAME\n", 6 }, { sink->yuv, luma * 3 / 2 } };
+         ok = io_write_batch(sink->fd, iov, 2); // one submission with the uring backend
+      } else if (!failed) {
+         ok = io_write_all(sink->fd, rgb, sink->frame_size);
+      }
+
+      pthread_mutex_lock(&sink->mtx);
+      if (!ok && !sink->failed) {
+         fprintf(stderr, "\033[1;31mERROR\033[0m: Video sink write failed, stream stopped\r\n");
+         sink->failed = true;
+      }
+      sink->tail = (sink->tail + 1) % SINK_SLOTS;
+      sink->full -= 1;
+      pthread_cond_signal(&sink->cond_free);
+   }
+   pthread_mutex_unlock(&sink->mtx);
+   return NULL;
+}
+
+// - function -----------------------------------------------------------------
+static inline unsigned char clamp_u8(int v)
+{
+   return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+// - function -----------------------------------------------------------------
+static inline v4si clamp_v4(v4si v)
+{
+   const v4si zero = { 0 };
+   const v4si max = zero + 255;
+   v4si m = v > max;
+   v = (v & ~m) | (max & m);
+   m = v < zero;
+   return v & ~m;
+}
+
+// - function -----------------------------------------------------------------
+void sink_rgb_to_yuv420(const unsigned char *rgb, int w, int h, unsigned char *y, unsigned char *u, unsigned char *v)
+{
+   // BT.601 full range in 8.8 fixed point; chroma from the sum of each 2x2 block
+   const int cw = w / 2;
+   for (int row = 0; row < h; row += 2) {
+      const unsigned char *p0 = rgb + (size_t)row * w * 3;
+      const unsigned char *p1 = p0 + (size_t)w * 3;
+      unsigned char *y0 = y + (size_t)row * w;
+      unsigned char *y1 = y0 + w;
+      unsigned char *pu = u + (size_t)(row / 2) * cw;
+      unsigned char *pv = v + (size_t)(row / 2) * cw;
+      int x = 0;
+      for (; x + SINK_BLOCK <= w; x += SINK_BLOCK) {
+         // deinterleave even/odd columns of both rows into the vector lanes
+         v4si r[4], g[4], b[4]; // row0 even, row0 odd, row1 even, row1 odd
+         for (int j = 0; j < SINK_LANES; ++j) {
+            const unsigned char *q[4] = { p0 + (x + 2 * j) * 3, p0 + (x + 2 * j + 1) * 3, p1 + (x + 2 * j) * 3, p1 + (x + 2 * j + 1) * 3 };
+            for (int k = 0; k < 4; ++k) {
+               r[k][j] = q[k][0];
+               g[k][j] = q[k][1];
+               b[k][j] = q[k][2];
+            }
+         }
+         v4si luma[4];
+         for (int k = 0; k < 4; ++k) {
+            luma[k] = (77 * r[k] + 150 * g[k] + 29 * b[k] + 128) >> 8;
+         }
+         const v4si rs = r[0] + r[1] + r[2] + r[3];
+         const v4si gs = g[0] + g[1] + g[2] + g[3];
+         const v4si bs = b[0] + b[1] + b[2] + b[3];
+         const v4si cb = clamp_v4(((-43 * rs - 85 * gs + 128 * bs + 512) >> 10) + 128);
+         const v4si cr = clamp_v4(((128 * rs - 107 * gs - 21 * bs + 512) >> 10) + 128);
+         for (int j = 0; j < SINK_LANES; ++j) {
+            y0[x + 2 * j] = luma[0][j];
+            y0[x + 2 * j + 1] = luma[1][j];
+            y1[x + 2 * j] = luma[2][j];
+            y1[x + 2 * j + 1] = luma[3][j];
+            pu[x / 2 + j] = cb[j];
+            pv[x / 2 + j] = cr[j];
+         }
+      }
+      for (; x < w; x += 2) { // scalar tail
+         int rs = 0, gs = 0, bs = 0;
+         for (int k = 0; k < 4; ++k) {
+            const unsigned char *q = (k < 2 ? p0 : p1) + (x + (k & 1)) * 3;
+            (k < 2 ? y0 : y1)[x + (k & 1)] = (77 * q[0] + 150 * q[1] + 29 * q[2] + 128) >> 8;
+            rs += q[0];
+            gs += q[1];
+            bs += q[2];
+         }
+         pu[x / 2] = clamp_u8(((-43 * rs - 85 * gs + 128 * bs + 512) >> 10) + 128);
+         pv[x / 2] = clamp_u8(((128 * rs - 107 * gs - 21 * bs + 512) >> 10) + 128);
+      }
+   }
+}
+
+/* end of video_sink.c */
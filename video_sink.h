@@ -0,0 +1,60 @@
+/*
+ * Filename: video_sink.h
+ * Date:     2026/10/19
+ */
+
+#ifndef __VIDEO_SINK_H__
+#define __VIDEO_SINK_H__
+
+#include <stdbool.h>
+
+typedef enum {
+   SINK_Y4M,   // YUV4MPEG2 stream, 4:2:0 full range (C420jpeg)
+   SINK_RGB,   // raw rgb24 frames without any header
+} sink_format;
+
+typedef struct video_sink video_sink;
+
+/// ----------------------------------------------------------------------------
+/// @brief sink_open
+///
+/// @param fname  -- output file name, "-" writes to the standard output
+/// @param fmt    -- stream format
+/// @param w, h   -- frame size (even numbers for SINK_Y4M)
+/// @param fps    -- nominal frame rate written into the y4m header
+///
+/// @return sink handle or NULL on error
+///
+/// The sink owns two frame slots and an encoder thread. Frames are converted
+/// and written by the encoder thread, so the caller only pays for one memcpy.
+/// ----------------------------------------------------------------------------
+video_sink *sink_open(const char *fname, sink_format fmt, int w, int h, int fps);
+
+/// ----------------------------------------------------------------------------
+/// @brief sink_push
+///
+/// @param sink
+/// @param rgb    -- w * h * 3 bytes of the frame, copied before return
+///
+/// @return false if the encoder failed to write the stream
+///
+/// Blocks only if both slots are still waiting for the encoder (backpressure).
+/// ----------------------------------------------------------------------------
+bool sink_push(video_sink *sink, const unsigned char *rgb);
+
+/// ----------------------------------------------------------------------------
+/// @brief sink_close -- flush pending frames, join the encoder and free the sink
+/// ----------------------------------------------------------------------------
+void sink_close(video_sink *sink);
+
+/// ----------------------------------------------------------------------------
+/// @brief sink_rgb_to_yuv420 -- convert one rgb24 frame into planar 4:2:0
+///
+/// @param y      -- w * h bytes
+/// @param u, v   -- (w / 2) * (h / 2) bytes each
+/// ----------------------------------------------------------------------------
+void sink_rgb_to_yuv420(const unsigned char *rgb, int w, int h, unsigned char *y, unsigned char *u, unsigned char *v);
+
+#endif
+
+/* end of video_sink.h */
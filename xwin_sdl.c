@@ -5,6 +5,9 @@
  */
 
 #include <assert.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <string.h>
 
 #include <SDL.h>
 
@@ -14,6 +17,31 @@
 
 static SDL_Window *win = NULL;
 
+#define HUD_SCALE 2    // of the 3x5 glyphs
+#define HUD_PAD 4
+#define HUD_CELL_W 12
+#define HUD_CELL_H 6
+
+static xwin_hud hud;
+static bool hud_on = false;
+static SDL_Rect hud_rect;  // the part of the window covered by the overlay last time
+
+static SDL_Rect hud_bounds(SDL_Surface *scr);
+static void draw_hud(SDL_Surface *scr, int w, const unsigned char *img);
+
+// 3x5 glyphs, a row per octal digit from the top, bit 4 is the left column
+static const unsigned short font[128] = {
+   ['0'] = 075557, ['1'] = 026227, ['2'] = 071747, ['3'] = 071317, ['4'] = 055711,
+   ['5'] = 074717, ['6'] = 074757, ['7'] = 071111, ['8'] = 075757, ['9'] = 075717,
+   ['A'] = 025755, ['B'] = 065656, ['C'] = 034443, ['D'] = 065556, ['E'] = 074647,
+   ['F'] = 074644, ['G'] = 034553, ['H'] = 055755, ['I'] = 072227, ['J'] = 011152,
+   ['K'] = 055655, ['L'] = 044447, ['M'] = 057755, ['N'] = 065555, ['O'] = 025552,
+   ['P'] = 065644, ['Q'] = 025563, ['R'] = 065655, ['S'] = 034216, ['T'] = 072222,
+   ['U'] = 055557, ['V'] = 055552, ['W'] = 055775, ['X'] = 055255, ['Y'] = 055222,
+   ['Z'] = 071247, ['.'] = 000002, ['/'] = 011244, [':'] = 002020, ['-'] = 000700,
+   ['%'] = 051245,
+};
+
 static unsigned char icon_32x32_bits[] = {
    0x00, 0x00, 0x21, 0x00, 0x00, 0x21, 0x00, 0x00, 0x21, 0x00, 0x00, 0x21, 0x00, 0x00, 0x21, 0x00, 0x00, 0x20, 0x00, 0x00, 0x23, 0x00, 0x01, 0x29, 0x00, 0x01, 0x2e, 0x00, 0x02, 0x31, 0x00, 0x02, 0x34, 0x00, 0x02, 0x35, 0x00, 0x02, 0x33, 0x00, 0x02, 0x31, 0x00, 0x01, 0x2d, 0x00, 0x01, 0x29, 0x00, 0x00, 0x23, 0x00, 0x00, 0x20, 0x00, 0x00, 0x21, 0x00, 0x00, 0x21, 0x00, 0x00, 0x21, 0x00, 0x00, 0x21, 0x00, 0x00, 0x21, 0x00, 0x00, 0x21, 0x00, 0x00, 0x21, 0x00, 0x00, 0x21, 0x00, 0x00, 0x21, 0x00, 0x00, 0x21, 0x00, 0x00, 0x21, 0x00, 0x00, 0x21, 0x00, 0x00, 0x21, 0x00, 0x00, 0x21,
    0x00, 0x00, 0x21, 0x00, 0x00, 0x21, 0x00, 0x00, 0x21, 0x00, 0x00, 0x23, 0x00, 0x01, 0x2b, 0x00, 0x02, 0x3b, 0x00, 0x03, 0x41, 0x00, 0x03, 0x43, 0x00, 0x04, 0x46, 0x00, 0x04, 0x49, 0x00, 0x05, 0x4d, 0x00, 0x04, 0x46, 0x00, 0x03, 0x43, 0x00, 0x03, 0x3f, 0x00, 0x03, 0x40, 0x00, 0x03, 0x41, 0x00, 0x03, 0x42, 0x00, 0x03, 0x3c, 0x00, 0x01, 0x2d, 0x00, 0x00, 0x24, 0x00, 0x00, 0x20, 0x00, 0x00, 0x21, 0x00, 0x00, 0x21, 0x00, 0x00, 0x21, 0x00, 0x00, 0x21, 0x00, 0x00, 0x21, 0x00, 0x00, 0x21, 0x00, 0x00, 0x21, 0x00, 0x00, 0x21, 0x00, 0x00, 0x21, 0x00, 0x00, 0x21, 0x00, 0x00, 0x21,
@@ -73,6 +101,7 @@ void xwin_close()
 void xwin_redraw(int w, int h, unsigned char *img) {
   assert(img && win);
   SDL_Surface *scr = SDL_GetWindowSurface(win);
+  const unsigned char *src = img;
   for (int y = 0; y < scr->h; ++y) {
     for (int x = 0; x < scr->w; ++x) {
       const int idx = (y * scr->w + x) * scr->format->BytesPerPixel;
@@ -82,6 +111,10 @@ void xwin_redraw(int w, int h, unsigned char *img) {
       *(px + scr->format->Bshift / 8) = *(img++);
     }
   }
+  if (hud_on) {
+    hud_rect = hud_bounds(scr);
+    draw_hud(scr, w, src);
+  }
   SDL_UpdateWindowSurface(win);
 }
 
@@ -91,4 +124,120 @@ void xwin_poll_events(void)
    while (SDL_PollEvent(&event));
 }
 
+static inline void put_px(SDL_Surface *scr, int x, int y, Uint8 r, Uint8 g, Uint8 b)
+{
+   Uint8 *px = (Uint8 *)scr->pixels + y * scr->pitch + x * scr->format->BytesPerPixel;
+   *(px + scr->format->Rshift / 8) = r;
+   *(px + scr->format->Gshift / 8) = g;
+   *(px + scr->format->Bshift / 8) = b;
+}
+
+// lines of the overlay text up to the last nonempty one, and its longest line
+static int hud_lines(int *cols)
+{
+   int lines = 0;
+   *cols = 0;
+   for (int i = 0; i < XWIN_HUD_LINES; ++i) {
+      const int n = strlen(hud.line[i]);
+      lines = n ? i + 1 : lines;
+      *cols = n > *cols ? n : *cols;
+   }
+   return lines;
+}
+
+// the rectangle of the overlay within the window
+static SDL_Rect hud_bounds(SDL_Surface *scr)
+{
+   int cols;
+   const int lines = hud_lines(&cols);
+   int w = cols * 4 * HUD_SCALE;
+   int h = lines * 7 * HUD_SCALE;
+   if (hud.n_re > 0 && hud.n_im > 0) {
+      w = hud.n_re * HUD_CELL_W > w ? hud.n_re * HUD_CELL_W : w;
+      h += hud.n_im * HUD_CELL_H;
+   }
+   SDL_Rect r = { 0, 0, w + 2 * HUD_PAD, h + 2 * HUD_PAD };
+   r.w = r.w < scr->w ? r.w : scr->w;
+   r.h = r.h < scr->h ? r.h : scr->h;
+   return r;
+}
+
+// copy rect of img into the window surface
+static void copy_rect(SDL_Surface *scr, int w, const unsigned char *img, const SDL_Rect *r)
+{
+   for (int y = r->y; y < r->y + r->h; ++y) {
+      const unsigned char *p = img + (y * w + r->x) * 3;
+      for (int x = r->x; x < r->x + r->w; ++x, p += 3) {
+         put_px(scr, x, y, p[0], p[1], p[2]);
+      }
+   }
+}
+
+// the overlay over the image already in the surface, only its rectangle is touched
+static void draw_hud(SDL_Surface *scr, int w, const unsigned char *img)
+{
+   const SDL_Rect r = hud_rect;
+   for (int y = r.y; y < r.y + r.h; ++y) { // darkened background
+      const unsigned char *p = img + (y * w + r.x) * 3;
+      for (int x = r.x; x < r.x + r.w; ++x, p += 3) {
+         put_px(scr, x, y, p[0] >> 2, p[1] >> 2, p[2] >> 2);
+      }
+   }
+   int cols;
+   const int lines = hud_lines(&cols);
+   int y0 = r.y + HUD_PAD;
+   for (int i = 0; i < lines; ++i, y0 += 7 * HUD_SCALE) {
+      int x0 = r.x + HUD_PAD;
+      for (const char *c = hud.line[i]; *c; ++c, x0 += 4 * HUD_SCALE) {
+         const unsigned short g = font[toupper((unsigned char)*c) & 0x7f];
+         for (int gy = 0; gy < 5 * HUD_SCALE; ++gy) {
+            for (int gx = 0; gx < 3 * HUD_SCALE; ++gx) {
+               const int x = x0 + gx;
+               const int y = y0 + gy;
+               if (x < r.x + r.w && y < r.y + r.h && (g >> (3 * (4 - gy / HUD_SCALE))) & (4 >> (gx / HUD_SCALE))) {
+                  put_px(scr, x, y, 255, 255, 255);
+               }
+            }
+         }
+      }
+   }
+   for (int i = 0; i < hud.n_re * hud.n_im && i < XWIN_HUD_CELLS; ++i) {
+      const float v = hud.heat[i];
+      const Uint8 red = v < 0 ? 48 : 255 * v;
+      const Uint8 blue = v < 0 ? 48 : 255 * (1 - v);
+      const int cx = r.x + HUD_PAD + (i % hud.n_re) * HUD_CELL_W;
+      const int cy = y0 + (i / hud.n_re) * HUD_CELL_H;
+      for (int y = cy; y < cy + HUD_CELL_H - 1 && y < r.y + r.h; ++y) {
+         for (int x = cx; x < cx + HUD_CELL_W - 1 && x < r.x + r.w; ++x) {
+            put_px(scr, x, y, red, v < 0 ? 48 : 32, blue);
+         }
+      }
+   }
+}
+
+void xwin_set_hud(const xwin_hud *h)
+{
+   hud_on = h != NULL;
+   if (h) {
+      hud = *h;
+   }
+}
+
+void xwin_redraw_hud(int w, int h, const unsigned char *img)
+{
+   assert(img && win);
+   SDL_Surface *scr = SDL_GetWindowSurface(win);
+   SDL_Rect r = hud_rect; // the old overlay may be larger than the new one
+   copy_rect(scr, w, img, &r);
+   if (hud_on) {
+      hud_rect = hud_bounds(scr);
+      draw_hud(scr, w, img);
+      r.w = hud_rect.w > r.w ? hud_rect.w : r.w;
+      r.h = hud_rect.h > r.h ? hud_rect.h : r.h;
+   } else {
+      hud_rect = (SDL_Rect){ 0, 0, 0, 0 };
+   }
+   SDL_UpdateWindowSurfaceRects(win, &r, 1);
+}
+
 /* end of xwin_sdl.c */
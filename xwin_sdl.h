@@ -7,11 +7,28 @@
 #ifndef __XWIN_SDL_H__
 #define __XWIN_SDL_H__
 
+#define XWIN_HUD_LINES 6
+#define XWIN_HUD_COLS 20
+#define XWIN_HUD_CELLS 256
+
+typedef struct { // performance overlay in the upper left corner of the window
+   char line[XWIN_HUD_LINES][XWIN_HUD_COLS + 1]; // digits, letters and . / : - %
+   int n_re;                   // heatmap of n_re x n_im cells below the text, 0 for none
+   int n_im;
+   float heat[XWIN_HUD_CELLS]; // cell values in [0, 1], < 0 if unknown
+} xwin_hud;
+
 int xwin_init(int w, int h);
 void xwin_close();
 void xwin_redraw(int w, int h, unsigned char *img);
 void xwin_poll_events(void);
 
+// overlay drawn by every redraw over img, NULL to hide it
+void xwin_set_hud(const xwin_hud *hud);
+
+// repaint only the part of the window the overlay covers (or covered) from img
+void xwin_redraw_hud(int w, int h, const unsigned char *img);
+
 #endif
 
 /* end of xwin_sdl.h */